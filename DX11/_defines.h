@@ -8,6 +8,7 @@
 
 typedef signed char sbyte;
 typedef unsigned char ubyte;
+typedef unsigned short ushort;
 typedef unsigned int uint;
 typedef unsigned long long ulong;
 typedef signed long long slong;
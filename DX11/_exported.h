@@ -10,9 +10,23 @@ void throwOnDXError(HRESULT hr, const char* msg = nullptr);
 #include "sampler.h"
 #include "textures.h"
 #include "shaders.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "slot_range.h"
+#include "utf8.h"
+#include "skyline_packer.h"
+#include "glyph_cache.h"
 #include "font.h"
+#include "sdf_generator.h"
+#include "text_layout.h"
 #include "dx11.h"
+#include "animation.h"
+#include "quad_grid.h"
 #include "quad.h"
+#include "text_chunks.h"
 #include "text.h"
+#include "text_batch.h"
+#include "gpu_text.h"
+#include "text_view.h"
 #include "shader_printf.h"
 
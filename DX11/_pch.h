@@ -15,7 +15,6 @@
 #define NOCTLMGR
 #define NOCLIPBOARD
 #define NODRAWTEXT
-#define NOTEXTMETRIC
 //#define NOGDI
 #define NOBITMAP
 #define NOMCX	
@@ -28,6 +27,8 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cassert>
+#include <cmath>
+#include <emmintrin.h>
 
 /// DirectX stuff
 #include <d3d11.h>	
@@ -45,12 +46,23 @@
 
 /// std namespace files
 #include <vector>
+#include <algorithm>
 #include <chrono>
 #include <string>
 #include <unordered_map>
 #include <exception>
 #include <memory>
 #include <random>
+#include <bit>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <list>
+#include <array>
 
 using std::shared_ptr;
 using std::unique_ptr;
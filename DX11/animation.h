@@ -0,0 +1,61 @@
+#pragma once
+///
+///	Animation evaluated in the vertex shader.
+///
+///	Text and Quad can store one of these per glyph/quad in a second vertex stream. The
+///	vertex shader evaluates it against the frame time (FrameResource::nsecs) so fades,
+///	scrolls, typewriter reveals and pulsing colours cost no uploads after the element
+///	has been built. Times are in seconds.
+///
+///	An element is hidden until its reveal time: startTime + revealIndex * revealInterval.
+///	After that it moves at _velocity_ and its colour ramps to _rampColour_ over
+///	_rampDuration_ seconds (forwards and back forever if _pingPong_ is set).
+///
+namespace dx11 {
+
+struct Animation final {
+	float delay = 0;				/// start this long after the element is added
+	float2 velocity = {0, 0};		/// pixels per second
+	rgba rampColour = rgba{1, 1, 1, 1};
+	float rampDuration = 0;			/// 0 = no colour ramp
+	bool pingPong = false;
+	float revealInterval = 0;		/// seconds between consecutive glyphs/quads. 0 = all at once
+};
+
+/// Per vertex (or per instance) animation data. Vertex stream 1
+struct AnimationVertex final {
+	float startTime;
+	float revealTime;
+	float2 velocity;
+	uint rampColour;	/// rgba8
+	float rampDuration;
+	float pingPong;
+	float _pad;
+
+	static AnimationVertex make(const Animation& a, float startTime, uint revealIndex) {
+		return {
+			startTime,
+			startTime + a.revealInterval * (float)revealIndex,
+			a.velocity,
+			a.rampColour.toRGBA8(),
+			a.rampDuration,
+			a.pingPong ? 1.0f : 0.0f,
+			0
+		};
+	}
+	/// The frame time in seconds as seen by the shaders
+	static float time(const FrameResource& frame) {
+		return (float)((double)frame.nsecs * 1e-9);
+	}
+	/// Append the input elements for slot 1
+	static void addInputElements(vector<D3D11_INPUT_ELEMENT_DESC>& layout, bool perInstance) {
+		auto cls  = perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		uint step = perInstance ? 1 : 0;
+		layout.push_back({"ANIMTIME",  0, DXGI_FORMAT_R32G32_FLOAT,   1, D3D11_APPEND_ALIGNED_ELEMENT, cls, step});
+		layout.push_back({"VELOCITY",  0, DXGI_FORMAT_R32G32_FLOAT,   1, D3D11_APPEND_ALIGNED_ELEMENT, cls, step});
+		layout.push_back({"RAMPCOLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, cls, step});
+		layout.push_back({"RAMP",      0, DXGI_FORMAT_R32G32_FLOAT,   1, D3D11_APPEND_ALIGNED_ELEMENT, cls, step});
+	}
+}; static_assert(8 * 4 == sizeof(AnimationVertex));
+
+} /// dx11
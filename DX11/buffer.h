@@ -52,9 +52,9 @@ protected:
 
 		if(initialData) {
 			D3D11_SUBRESOURCE_DATA data = {initialData};
-            throwOnDXError(device->CreateBuffer(&bufferDesc, &data, handle.GetAddressOf()), "CreateBuffer");
+            throwOnDXError(device->CreateBuffer(&bufferDesc, &data, handle.ReleaseAndGetAddressOf()), "CreateBuffer");
 		} else {
-            throwOnDXError(device->CreateBuffer(&bufferDesc, nullptr, handle.GetAddressOf()), "CreateBuffer");
+            throwOnDXError(device->CreateBuffer(&bufferDesc, nullptr, handle.ReleaseAndGetAddressOf()), "CreateBuffer");
 		}
 		isInitialised = true;
 	}
@@ -75,6 +75,17 @@ public:
 		_usage = D3D11_USAGE::D3D11_USAGE_IMMUTABLE;
 		Buffer::init(device, numVertices*sizeof(T), initialData);
 	}
+	/// For data that is rewritten every frame. Each write() discards the previous contents so
+	/// it must include everything that will be drawn
+	void initStreaming(ComPtr<ID3D11Device> device, uint numVertices) {
+		_usage     = D3D11_USAGE::D3D11_USAGE_DYNAMIC;
+		_cpuAccess = D3D11_CPU_ACCESS_FLAG::D3D11_CPU_ACCESS_WRITE;
+		Buffer::init(device, numVertices * sizeof(T), nullptr);
+	}
+	void release() {
+		handle.Reset();
+		isInitialised = false;
+	}
     void write(ComPtr<ID3D11DeviceContext> context, const T* vertices, uint startVertex = 0, uint numVertices = 0) const {
         Buffer::write(context, vertices, startVertex*sizeof(T), numVertices*sizeof(T));
     }
@@ -264,4 +275,30 @@ public:
         Buffer::write(context, data, startUint * sizeof(uint), numUints * sizeof(uint));
     }
 };
+//=========================================================================== IndirectArgsBuffer
+/// Arguments for DrawInstancedIndirect/DispatchIndirect. The uav is R32_UINT so that a
+/// compute shader can fill in the counts
+class IndirectArgsBuffer final : public Buffer {
+public:
+    ComPtr<ID3D11UnorderedAccessView> uav;
+
+    IndirectArgsBuffer() {
+        _bindFlags = D3D11_BIND_FLAG::D3D11_BIND_UNORDERED_ACCESS;
+        _usage = D3D11_USAGE::D3D11_USAGE_DEFAULT;
+        _misc = D3D11_RESOURCE_MISC_FLAG::D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+    }
+    void init(ComPtr<ID3D11Device> device, uint numUints, const uint* initialData = nullptr) {
+        Buffer::init(device, numUints * 4, initialData);
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC desc = {};
+        desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        desc.Format = DXGI_FORMAT::DXGI_FORMAT_R32_UINT;
+        desc.Buffer.FirstElement = 0;
+        desc.Buffer.NumElements = numUints;
+        throwOnDXError(device->CreateUnorderedAccessView(handle.Get(), &desc, uav.GetAddressOf()));
+    }
+    void write(ComPtr<ID3D11DeviceContext> context, const uint* data, uint startUint = 0, uint numUints = 0) const {
+        Buffer::write(context, data, startUint * sizeof(uint), numUints * sizeof(uint));
+    }
+};
 } /// dx11
\ No newline at end of file
@@ -61,6 +61,8 @@ public:
 	ComPtr<IDXGIAdapter3> adapter;
 	ComPtr<ID3D11Device> device;
 	ComPtr<ID3D11DeviceContext> context;
+	class ThreadPool threads{};		/// parallelFor work: Text and Quad rebuilds, SDF generation
+	class ThreadPool loaders{2};	/// Fonts::getAsync() loads, kept off threads
 	class Shaders shaders{*this};
 	class Textures textures{*this};
 	class Fonts fonts{*this};
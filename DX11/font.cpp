@@ -5,9 +5,34 @@ namespace dx11 {
 
 using namespace core;
 
-const constexpr uint BM_WIDTH = 512;
+const constexpr uint FONT_BINARY_MAGIC   = 0x544e4642; /// "BFNT"
+const constexpr uint FONT_BINARY_VERSION = 3;	/// 3: UVs relative to the atlas size from the .fnt
 
-static FontChar readChar(const string& lineIn) {
+///
+///	Binary font file layout:
+///		FontBinaryHeader
+///		FontChar[numChars]
+///		FontKerning::Pair[numKernings]
+///		ubyte[atlasWidth*atlasHeight]	(R8 atlas)
+///
+struct FontBinaryHeader final {
+	uint magic;
+	uint version;
+	uint size, width, height, lineHeight, base;
+	uint numChars;
+	uint numKernings;
+	uint atlasWidth, atlasHeight;
+}; static_assert(11 * 4 == sizeof(FontBinaryHeader));
+
+/// Returns 0 if the file does not exist
+static ulong getModifiedTime(const wstring& filename) {
+	WIN32_FILE_ATTRIBUTE_DATA data = {};
+	if(!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data)) return 0;
+	return ((ulong)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
+/// UVs are relative to the scaleW x scaleH atlas from the common line
+static FontChar readChar(const string& lineIn, uint scaleW, uint scaleH) {
 	FontChar c = {};
 	string line = String::trimBoth(lineIn);
 	// assumes there are no spaces around '='
@@ -25,23 +50,106 @@ static FontChar readChar(const string& lineIn) {
 	c.xoffset = String::toInt(map["xoffset"]);
 	c.yoffset = String::toInt(map["yoffset"]);
 	c.xadvance = String::toInt(map["xadvance"]);
-	c.u = x / BM_WIDTH;
-	c.v = y / BM_WIDTH;
-	c.u2 = (x + c.width - 1) / BM_WIDTH;
-	c.v2 = (y + c.height - 1) / BM_WIDTH;
+	c.u = x / scaleW;
+	c.v = y / scaleH;
+	c.u2 = (x + c.width - 1) / scaleW;
+	c.v2 = (y + c.height - 1) / scaleH;
 	return c;
 }
 
-Rect Font::getRect(const string& text, float size) {
+void FontKerning::build(vector<Pair> newPairs) {
+	/// Stable sort so that the last duplicate wins
+	std::stable_sort(newPairs.begin(), newPairs.end(), [](const Pair& a, const Pair& b) {
+		return a.first < b.first || (a.first == b.first && a.second < b.second);
+	});
+	pairs.clear();
+	pairs.reserve(newPairs.size());
+	for(auto& p : newPairs) {
+		if(!pairs.empty() && pairs.back().first == p.first && pairs.back().second == p.second) {
+			pairs.back().amount = p.amount;
+		} else {
+			pairs.push_back(p);
+		}
+	}
+	runs.clear();
+	memset(directRun, 0, sizeof(directRun));
+	for(uint i = 0; i < (uint)pairs.size(); i++) {
+		if(runs.empty() || runs.back().first != pairs[i].first) {
+			runs.push_back({pairs[i].first, i, 0});
+			if(pairs[i].first < DIRECT_SIZE) directRun[pairs[i].first] = (uint)runs.size();
+		}
+		runs.back().count++;
+	}
+}
+void FontPage::add(const FontChar& c) {
+	if(auto existing = find(c.id)) {
+		glyphs[existing - glyphs.data()] = c;
+	} else {
+		uint index = (uint)glyphs.size();
+		glyphs.push_back(c);
+
+		if(c.id < 0x10000) {
+			uint& block = blockIndex[c.id / BLOCK_SIZE];
+			if(block == 0) {
+				block = (uint)(blocks.size() / BLOCK_SIZE);
+				blocks.resize(blocks.size() + BLOCK_SIZE, NONE);
+			}
+			blocks[block * BLOCK_SIZE + (c.id % BLOCK_SIZE)] = index;
+		} else {
+			auto it = std::lower_bound(astral.begin(), astral.end(), c.id, [&](uint i, uint id) { return glyphs[i].id < id; });
+			astral.insert(it, index);
+		}
+	}
+	if(c.id < DIRECT_SIZE) direct[c.id] = c;
+}
+void FontPage::remove(uint ch) {
+	auto g = find(ch);
+	if(!g) return;
+	uint index = (uint)(g - glyphs.data());
+	uint last  = (uint)glyphs.size() - 1;
+
+	const auto byId = [&](uint i, uint id) { return glyphs[i].id < id; };
+	/// Returns the slot holding the glyph index for _id_. The glyph must be present
+	const auto slot = [&](uint id)->uint& {
+		if(id < 0x10000) return blocks[blockIndex[id / BLOCK_SIZE] * BLOCK_SIZE + (id % BLOCK_SIZE)];
+		return *std::lower_bound(astral.begin(), astral.end(), id, byId);
+	};
+	if(ch < 0x10000) {
+		slot(ch) = NONE;
+	} else {
+		astral.erase(std::lower_bound(astral.begin(), astral.end(), ch, byId));
+	}
+	if(index != last) {
+		slot(glyphs[last].id) = index;
+	}
+	glyphs[index] = glyphs[last];
+	glyphs.pop_back();
+
+	if(ch < DIRECT_SIZE) direct[ch] = fallback;
+}
+void FontPage::setFallback(uint ch) {
+	auto g = find(ch);
+	fallback = g ? *g : FontChar{};
+	for(uint i = 0; i < DIRECT_SIZE; i++) {
+		if(!find(i)) direct[i] = fallback;
+	}
+}
+Rect Font::measure(const string& text, float size) const {
 	Rect r = {};
 	if(text.size() == 0) return r;
 	r.x = 1000;
 	r.y = 1000;
 	float X = 0;
-	int i = 0;
-	for(auto ch : text) {
-		auto g		= getChar(ch); 
-		float ratio = (size / (float)this->size);
+	float ratio = (size / (float)this->size);
+	bool kern = hasKerning();
+	uint prev = 0;
+	bool first = true;
+	utf8::forEach(text, [&](uint ch) {
+		auto& g = getChar(ch);
+
+		if(kern && !first) {
+			X += getKerning(prev, ch) * ratio;
+		}
 
 		float x = X + g.xoffset * ratio;
 		float y = 0 + g.yoffset * ratio;
@@ -53,28 +161,198 @@ Rect Font::getRect(const string& text, float size) {
 		if(xx > r.width) r.width = xx;
 		if(yy > r.height) r.height = yy;
 
-		int kerning = 0;
-		if(i+1<text.size()) {
-			kerning = getKerning(ch, text[i + 1]);
-		}
-		X += (g.xadvance + kerning) * ratio;
-	}
+		X += g.xadvance * ratio;
+		prev = ch;
+		first = false;
+	});
 	return r;
 }
 
+bool Font::prepare(const string& text) {
+	return glyphCache ? glyphCache->prepare(*this, text) : true;
+}
+void Font::updateAtlas(ComPtr<ID3D11DeviceContext> context) {
+	if(glyphCache && glyphCache->hasUploads()) {
+		glyphCache->upload(*this, context);
+		atlasVersion++;
+	}
+}
+
+Fonts::~Fonts() {
+	/// Load tasks reference this object
+	vector<std::shared_future<Font*>> inFlight;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(auto& it : pending) inFlight.push_back(it.second);
+	}
+	for(auto& f : inFlight) f.wait();
+}
 Font* Fonts::get(const wstring& name) {
+	Promise promise;
+	auto future = acquire(name, promise);
+	if(promise) load(name, promise);
+	return future.get();
+}
+std::shared_future<Font*> Fonts::getAsync(const wstring& name) {
+	Promise promise;
+	auto future = acquire(name, promise);
+	if(promise) {
+		dx11.loaders.submit([this, name, promise] { load(name, promise); });
+	}
+	return future;
+}
+Font* Fonts::getTrueType(const wstring& ttfFilename, const wstring& faceName, const GlyphCacheParams& params) {
+	/// Fonts with different atlas params are different fonts
+	wstring key = faceName + L"@" + std::to_wstring(params.size) +
+				  L":" + std::to_wstring(params.spread) +
+				  L":" + std::to_wstring(params.oversample) +
+				  L":" + std::to_wstring(params.pageSize) +
+				  L"x" + std::to_wstring(params.numPages);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = fonts.find(key);
+		if(iter != fonts.end()) {
+			return iter->second.get();
+		}
+	}
+	/// Creating the GDI font and the atlas is slow so it is done without the lock. If another
+	/// thread creates the same font first this one is thrown away
+	auto font = std::make_unique<Font>();
+	font->name = key;
+	font->glyphCache = std::make_unique<GlyphCache>(*font, dx11.device, ttfFilename.empty() ? L"" : directory + ttfFilename, faceName, params);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto [iter, inserted] = fonts.try_emplace(key, std::move(font));
+	if(inserted) Log::format("Loaded TrueType font %s", WString::toString(key).c_str());
+	return iter->second.get();
+}
+std::shared_future<Font*> Fonts::acquire(const wstring& name, Promise& promise) {
+	std::lock_guard<std::mutex> lock(mutex);
+
 	auto iter = fonts.find(name);
 	if(iter != fonts.end()) {
-		return iter->second.get();
+		std::promise<Font*> ready;
+		ready.set_value(iter->second.get());
+		return ready.get_future().share();
 	}
-	Font font = {};
-	font.name = name;
-	readFontPage(font);
-	readFontTexture(font);
-	Log::format("Loaded font %s%s", WString::toString(directory).c_str(), WString::toString(name).c_str());
+	auto p = pending.find(name);
+	if(p != pending.end()) return p->second;
 
-	fonts[name] = std::make_unique<Font>(font);
-	return fonts[name].get();
+	promise = std::make_shared<std::promise<Font*>>();
+	auto future = promise->get_future().share();
+	pending[name] = future;
+	return future;
+}
+void Fonts::load(const wstring& name, Promise promise) {
+	try{
+		/// Constructed in place. Font is large and its measure cache holds iterators
+		auto font = std::make_unique<Font>();
+		font->name = name;
+		if(!readFontBinary(*font)) {
+			readFontPage(*font);
+			uint2 atlasSize;
+			auto atlas = readFontTexture(*font, atlasSize);
+			font->texture.init(dx11.device, atlasSize, DXGI_FORMAT::DXGI_FORMAT_R8_UNORM, 1, atlas.data());
+			writeFontBinary(*font, atlas.data(), atlasSize);
+		}
+		Log::format("Loaded font %s%s", WString::toString(directory).c_str(), WString::toString(name).c_str());
+
+		Font* ptr = font.get();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			fonts[name] = std::move(font);
+			pending.erase(name);
+		}
+		promise->set_value(ptr);
+	}catch(...) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending.erase(name);
+		}
+		promise->set_exception(std::current_exception());
+	}
+}
+bool Fonts::readFontBinary(Font& font) {
+	wstring filename = directory + font.name + L".fntbin";
+	ulong binaryTime = getModifiedTime(filename);
+	if(binaryTime == 0) return false;
+
+	/// Regenerate if the source files are newer
+	if(getModifiedTime(directory + font.name + L".fnt") > binaryTime ||
+	   getModifiedTime(directory + font.name + L".png") > binaryTime) return false;
+
+	MappedFile file;
+	if(!file.open(filename) || file.size() < sizeof(FontBinaryHeader)) return false;
+
+	auto header = (const FontBinaryHeader*)file.data();
+	if(header->magic != FONT_BINARY_MAGIC || header->version != FONT_BINARY_VERSION) return false;
+
+	ulong expectedSize = sizeof(FontBinaryHeader) +
+						 header->numChars * sizeof(FontChar) +
+						 header->numKernings * sizeof(FontKerning::Pair) +
+						 (ulong)header->atlasWidth * header->atlasHeight;
+	if(file.size() != expectedSize) {
+		Log::format("Font binary %s is corrupt", WString::toString(filename).c_str());
+		return false;
+	}
+
+	auto chars    = (const FontChar*)(file.data() + sizeof(FontBinaryHeader));
+	auto kernings = (const FontKerning::Pair*)(chars + header->numChars);
+	auto atlas    = (const ubyte*)(kernings + header->numKernings);
+
+	font.size       = header->size;
+	font.width      = header->width;
+	font.height     = header->height;
+	font.lineHeight = header->lineHeight;
+	font.base       = header->base;
+
+	font.page.reserve(header->numChars);
+	for(uint i = 0; i < header->numChars; i++) {
+		font.page.add(chars[i]);
+	}
+	font.page.setFallback(' ');
+	font.page.kerning.build(vector<FontKerning::Pair>(kernings, kernings + header->numKernings));
+
+	/// Upload the atlas straight from the mapping
+	font.texture.init(dx11.device, {header->atlasWidth, header->atlasHeight}, DXGI_FORMAT::DXGI_FORMAT_R8_UNORM, 1, atlas);
+	return true;
+}
+void Fonts::writeFontBinary(const Font& font, const ubyte* atlas, uint2 atlasSize) {
+	wstring filename = directory + font.name + L".fntbin";
+	wstring tempFilename = filename + L".tmp";
+
+	FontBinaryHeader header = {};
+	header.magic       = FONT_BINARY_MAGIC;
+	header.version     = FONT_BINARY_VERSION;
+	header.size        = font.size;
+	header.width       = font.width;
+	header.height      = font.height;
+	header.lineHeight  = font.lineHeight;
+	header.base        = font.base;
+	header.numChars    = font.page.count();
+	header.numKernings = font.page.kerning.count();
+	header.atlasWidth  = atlasSize.x;
+	header.atlasHeight = atlasSize.y;
+
+	auto& chars = font.page.all();
+
+	auto& kernings = font.page.kerning.all();
+
+	FILE* fp = nullptr;
+	if(_wfopen_s(&fp, tempFilename.c_str(), L"wb") != 0 || !fp) {
+		Log::format("Unable to write font binary %s", WString::toString(filename).c_str());
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	if(ok && !chars.empty())    ok = fwrite(chars.data(), sizeof(FontChar), chars.size(), fp) == chars.size();
+	if(ok && !kernings.empty()) ok = fwrite(kernings.data(), sizeof(FontKerning::Pair), kernings.size(), fp) == kernings.size();
+	if(ok) ok = fwrite(atlas, 1, (size_t)atlasSize.x * atlasSize.y, fp) == (size_t)atlasSize.x * atlasSize.y;
+	fclose(fp);
+
+	if(!ok || !MoveFileExW(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		Log::format("Unable to write font binary %s", WString::toString(filename).c_str());
+		DeleteFileW(tempFilename.c_str());
+	}
 }
 void Fonts::readFontPage(Font& font) {
 	const auto getFirstToken = [](string& line, ulong offset=0)->string { 
@@ -88,6 +366,8 @@ void Fonts::readFontPage(Font& font) {
 		return String::toInt(token);
 	};
 
+	vector<FontKerning::Pair> kernings;
+
 	FileReader<4096> reader{directory + font.name + L".fnt"};
 	while(!reader.eof()) {
 		string line = String::trimBoth(reader.readLine());
@@ -96,23 +376,28 @@ void Fonts::readFontPage(Font& font) {
 		//Log::format("firstToken='%s'", firstToken.c_str());
 
 		if(firstToken == "char") {
-			auto fc = readChar(line.substr(4));
-			font.page.chars[fc.id] = fc;
+			if(font.width == 0 || font.height == 0) {
+				throw std::runtime_error("Font '" + WString::toString(font.name) + "' has no common line before its chars");
+			}
+			font.page.add(readChar(line.substr(4), font.width, font.height));
 		} else if(firstToken == "kerning") {
-			ulong first = getInt(line, "first=");
-			ulong second = getInt(line, "second=");
+			uint first = getInt(line, "first=");
+			uint second = getInt(line, "second=");
 			int amount = getInt(line, "amount=");
-			font.page.kernings[(first << 32) | second] = amount;
+			kernings.push_back({first, second, amount});
 		} else if(firstToken == "info") {
 			font.size = getInt(line, "size=");
 		} else if(firstToken == "common") {
 			font.width = getInt(line, "scaleW=");
 			font.height = getInt(line, "scaleH=");
 			font.lineHeight = getInt(line, "lineHeight=");
+			font.base = getInt(line, "base=");
 		}
 	}
+	font.page.setFallback(' ');
+	font.page.kerning.build(std::move(kernings));
 }
-void Fonts::readFontTexture(Font& font) {
+vector<ubyte> Fonts::readFontTexture(Font& font, uint2& atlasSize) {
 	wstring filename = directory + font.name + L".png";
 	string filenameA = WString::toString(filename);
 	int x, y, n;
@@ -121,17 +406,16 @@ void Fonts::readFontTexture(Font& font) {
 
 	assert(n == 4);
 	/// Convert RGBA to single R channel
+	vector<ubyte> atlas((size_t)x*y);
 	ubyte* src = data+3;
-	ubyte* dest = data;
 	for(int i = 0; i < x*y; i++) {
-		*dest = *src;
-		dest++;
+		atlas[i] = *src;
 		src += 4;
 	}
-
-	font.texture.init(dx11.device, {BM_WIDTH, BM_WIDTH}, DXGI_FORMAT::DXGI_FORMAT_R8_UNORM, 1, data);
-	
 	free(data);
+
+	atlasSize = {(uint)x, (uint)y};
+	return atlas;
 }
 
 } /// dx11
\ No newline at end of file
@@ -10,52 +10,272 @@ struct FontChar final {
 	int xoffset, yoffset;
 	uint xadvance;
 };
+///================================================================================= FontKerning
+///
+///	Kerning pairs sorted by (first, second) and grouped into one run per first glyph.
+///	Runs for ASCII/Latin-1 first glyphs are found by direct index, others by binary search.
+///
+class FontKerning final {
+public:
+	struct Pair final {
+		uint first, second;
+		int amount;
+	}; static_assert(3 * 4 == sizeof(Pair));
+private:
+	struct Run final {
+		uint first, start, count;
+	};
+	static constexpr uint DIRECT_SIZE = 256;
+
+	vector<Pair> pairs;
+	vector<Run> runs;						/// sorted by first
+	uint directRun[DIRECT_SIZE] = {};		/// index+1 into runs, 0 = no run
+public:
+	bool empty() const { return pairs.empty(); }
+	uint count() const { return (uint)pairs.size(); }
+	const vector<Pair>& all() const { return pairs; }
+
+	int get(uint from, uint to) const {
+		const Run* run;
+		if(from < DIRECT_SIZE) {
+			uint r = directRun[from];
+			if(r == 0) return 0;
+			run = &runs[r - 1];
+		} else {
+			auto it = std::lower_bound(runs.begin(), runs.end(), from, [](const Run& r, uint f) { return r.first < f; });
+			if(it == runs.end() || it->first != from) return 0;
+			run = &*it;
+		}
+		const Pair* begin = pairs.data() + run->start;
+		const Pair* end   = begin + run->count;
+		if(run->count <= 8) {
+			for(auto p = begin; p < end; p++) {
+				if(p->second == to) return p->amount;
+			}
+			return 0;
+		}
+		auto p = std::lower_bound(begin, end, to, [](const Pair& p, uint s) { return p.second < s; });
+		return (p != end && p->second == to) ? p->amount : 0;
+	}
+	/// Replaces all pairs. Duplicate pairs keep the last amount
+	void build(vector<Pair> newPairs);
+};
 ///================================================================================= FontPage
+///
+///	Glyph lookup:
+///		- ASCII/Latin-1 glyphs are copied into a flat array indexed directly by codepoint
+///		- The rest of the BMP uses a two-level page table (256 blocks of 256 glyph indices)
+///		- Codepoints above the BMP are kept in a sorted array
+///
+///	Missing glyphs resolve to the fallback glyph (' ') which is set once at load time.
+///
 class FontPage final {
+	static constexpr uint DIRECT_SIZE = 256;
+	static constexpr uint BLOCK_SIZE  = 256;
+	static constexpr uint NONE        = 0xffffffff;
+
+	FontChar direct[DIRECT_SIZE] = {};
+	FontChar fallback = {};
+	vector<FontChar> glyphs;	/// all glyphs in load order
+	uint blockIndex[0x10000 / BLOCK_SIZE] = {};	/// block 0 is the empty block
+	vector<uint> blocks = vector<uint>(BLOCK_SIZE, NONE);
+	vector<uint> astral;		/// glyph indexes sorted by id
 public:
-	unordered_map<uint, FontChar> chars;
-	unordered_map<ulong, int> kernings; /// key = (from<<32 | to)
+	FontKerning kerning;
 
 	int getKerning(uint from, uint to) const {
-		auto iter = kernings.find(((ulong)from) << 32 | to);
-		if(iter == kernings.end()) return 0;
-		return iter->second;
+		return kerning.get(from, to);
+	}
+	const FontChar& operator[](uint ch) const {
+		if(ch < DIRECT_SIZE) return direct[ch];
+		auto g = find(ch);
+		return g ? *g : fallback;
 	}
-	const FontChar& operator[](uint ch) {
-		auto iter = chars.find(ch);
-		if(iter==chars.end()) return chars[' '];
-		return iter->second;
+	/// Returns nullptr if the glyph is not in this page
+	const FontChar* find(uint ch) const {
+		uint index = NONE;
+		if(ch < 0x10000) {
+			index = blocks[blockIndex[ch / BLOCK_SIZE] * BLOCK_SIZE + (ch % BLOCK_SIZE)];
+		} else {
+			auto it = std::lower_bound(astral.begin(), astral.end(), ch, [&](uint i, uint id) { return glyphs[i].id < id; });
+			if(it != astral.end() && glyphs[*it].id == ch) index = *it;
+		}
+		return index == NONE ? nullptr : &glyphs[index];
+	}
+	const vector<FontChar>& all() const { return glyphs; }
+	uint count() const { return (uint)glyphs.size(); }
+
+	void reserve(uint numGlyphs) { glyphs.reserve(numGlyphs); }
+	void add(const FontChar& c);
+	/// The last glyph is moved into the removed glyph's place
+	void remove(uint ch);
+	/// Call once all glyphs have been added
+	void setFallback(uint ch);
+};
+///================================================================================= FontMeasureCache
+///
+///	Bounded LRU cache of measured string rectangles keyed by (string hash, size).
+///	Each entry keeps a copy of its string so a hash collision is treated as a miss.
+///	Not thread safe.
+///
+class FontMeasureCache final {
+	struct Entry final {
+		ulong key;
+		float size;
+		string text;
+		Rect rect;
+	};
+	std::list<Entry> entries;		/// most recently used first
+	unordered_map<ulong, std::list<Entry>::iterator> map;
+	uint capacity = 1024;
+public:
+	ulong hits = 0, misses = 0;
+
+	/// Returns nullptr on a miss
+	const Rect* find(const string& text, float size) {
+		ulong k = key(text, size);
+		auto it = map.find(k);
+		if(it == map.end() || it->second->size != size || it->second->text != text) {
+			misses++;
+			return nullptr;
+		}
+		hits++;
+		entries.splice(entries.begin(), entries, it->second);
+		return &it->second->rect;
+	}
+	void insert(const string& text, float size, Rect rect) {
+		if(capacity == 0) return;
+		ulong k = key(text, size);
+		auto it = map.find(k);
+		if(it != map.end()) {
+			/// Collision or re-insert. Reuse the entry
+			*it->second = {k, size, text, rect};
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+		if(entries.size() >= capacity) {
+			map.erase(entries.back().key);
+			entries.pop_back();
+		}
+		entries.push_front({k, size, text, rect});
+		map[k] = entries.begin();
+	}
+	void setCapacity(uint numEntries) {
+		capacity = numEntries;
+		while(entries.size() > capacity) {
+			map.erase(entries.back().key);
+			entries.pop_back();
+		}
+	}
+	uint count() const { return (uint)entries.size(); }
+	void clear() {
+		entries.clear();
+		map.clear();
+	}
+	void resetCounters() { hits = misses = 0; }
+private:
+	static ulong key(const string& text, float size) {
+		return std::hash<string>()(text) ^ (std::bit_cast<uint>(size) * 0x9e3779b97f4a7c15ULL);
 	}
 };
 ///================================================================================= Font
+///
+///	Fonts either have a pre-baked atlas or, if glyphCache is set, an atlas that is filled on
+///	demand from a TrueType font. Dynamic fonts only know the glyphs that have been passed
+///	to prepare() and glyphs can be evicted, which increments _generation_.
+///
 class Font final {
 public:
 	FontPage page;
 	wstring name;
 	uint size, width, height, lineHeight;
+	uint base;		/// distance from the top of a line to the baseline
 	Texture2D texture;
+	unique_ptr<GlyphCache> glyphCache;
+	uint generation = 0;
+	uint atlasVersion = 0;	/// incremented whenever updateAtlas() changes the texture
+
+	bool isDynamic() const { return glyphCache != nullptr; }
+	/// Dynamic fonts: rasterise any glyphs in _text_ that are not in the atlas.
+	/// Returns false if the atlas is too small to hold them all
+	bool prepare(const string& text);
+	///	Dynamic fonts: glyphs prepared between these calls are not evicted by each other. Wrap
+	///	all the prepare() calls for the text about to be drawn so that later text cannot evict
+	///	glyphs that earlier text has already been written with
+	void beginPrepare() { if(glyphCache) glyphCache->beginBatch(); }
+	void endPrepare() { if(glyphCache) glyphCache->endBatch(); }
+	/// Dynamic fonts: upload glyphs rasterised since the last call
+	void updateAtlas(ComPtr<ID3D11DeviceContext> context);
 
 	int getKerning(uint from, uint to) const { 
 		return page.getKerning(from, to);
 	}
-	const FontChar& getChar(uint ch) {
+	/// Many fonts have no kerning pairs at all. Layout code can skip the lookups in that case
+	bool hasKerning() const {
+		return !page.kerning.empty();
+	}
+	const FontChar& getChar(uint ch) const {
 		return page[ch];
 	}
 	float2 getDimension(const string& text, float size) { return getRect(text, size).dimension(); }
-	Rect getRect(const string& text, float size);
+	/// Cached. Use measure() to bypass the cache. The cache of a dynamic font is cleared
+	/// whenever glyphs are added or evicted
+	Rect getRect(const string& text, float size) {
+		if(auto r = measureCache.find(text, size)) return *r;
+		Rect r = measure(text, size);
+		measureCache.insert(text, size, r);
+		return r;
+	}
+	/// Measure texts[i] into rects[i] at the same size
+	void getRects(const vector<string>& texts, float size, vector<Rect>& rects) {
+		rects.resize(texts.size());
+		for(size_t i = 0; i < texts.size(); i++) {
+			rects[i] = getRect(texts[i], size);
+		}
+	}
+	Rect measure(const string& text, float size) const;
+
+	FontMeasureCache measureCache;
 };
 ///================================================================================= Fonts
+///
+///	Fonts are loaded from a precompiled binary file (name.fntbin) which holds the glyph table,
+///	kerning table and the R8 atlas. This file is memory mapped and the atlas is uploaded
+///	directly from the mapping. If the binary file is missing, or older than the .fnt or .png
+///	then it is regenerated from those files.
+///
+///	get() and getAsync() are thread safe. getAsync() loads the font on DX11::loaders,
+///	including creating the texture (the device is free threaded), and the future resolves
+///	once the font is ready to use. Concurrent requests for the same font share one load.
+///	setDirectory() must not be called while loads are in flight.
+///
 class Fonts final {
 	wstring directory = L"./";
 	unordered_map<wstring, unique_ptr<Font>> fonts;
+	unordered_map<wstring, std::shared_future<Font*>> pending;
+	std::mutex mutex;
 	DX11& dx11;
 public:
 	Fonts(DX11& dx11) : dx11(dx11) {}
+	~Fonts();
+	/// Blocks until the font is loaded. Throws if it cannot be loaded
 	Font* get(const wstring& name);
+	std::shared_future<Font*> getAsync(const wstring& name);
+	/// A font with a dynamic atlas. _ttfFilename_ is relative to the font directory. If it
+	/// is empty _faceName_ must be an installed font. Each combination of face and params is
+	/// a separate font
+	Font* getTrueType(const wstring& ttfFilename, const wstring& faceName, const GlyphCacheParams& params = {});
 	void setDirectory(const wstring& dir) { this->directory = dir; }
 private:
+	using Promise = std::shared_ptr<std::promise<Font*>>;
+
+	/// Returns a null promise if the font is loaded or already loading
+	std::shared_future<Font*> acquire(const wstring& name, Promise& promise);
+	void load(const wstring& name, Promise promise);
+	bool readFontBinary(Font& font);
+	void writeFontBinary(const Font& font, const ubyte* atlas, uint2 atlasSize);
 	void readFontPage(Font& font);
-	void readFontTexture(Font& font);
+	vector<ubyte> readFontTexture(Font& font, uint2& atlasSize);
 };
 ///================================================================================= 
 
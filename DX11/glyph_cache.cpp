@@ -0,0 +1,188 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+GlyphCache::GlyphCache(Font& font, ComPtr<ID3D11Device> device, const wstring& ttfFilename, const wstring& faceName, const GlyphCacheParams& params)
+	: params(params), ttfFilename(ttfFilename)
+{
+	if(!ttfFilename.empty() && AddFontResourceExW(ttfFilename.c_str(), FR_PRIVATE, nullptr) == 0) {
+		throw std::runtime_error("Unable to load font '" + WString::toString(ttfFilename) + "'");
+	}
+	dc = CreateCompatibleDC(nullptr);
+	hfont = CreateFontW(-(int)(params.size * params.oversample), 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+						DEFAULT_CHARSET, OUT_TT_ONLY_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+						DEFAULT_PITCH, faceName.c_str());
+	if(!dc || !hfont) {
+		release();
+		throw std::runtime_error("Unable to create font '" + WString::toString(faceName) + "'");
+	}
+	SelectObject(dc, hfont);
+
+	float oversample = (float)params.oversample;
+	TEXTMETRICW tm = {};
+	GetTextMetricsW(dc, &tm);
+	font.size       = params.size;
+	font.base       = (uint)std::lround(tm.tmAscent / oversample);
+	font.lineHeight = (uint)std::lround((tm.tmHeight + tm.tmExternalLeading) / oversample);
+	font.width      = params.pageSize;
+	font.height     = params.pageSize * params.numPages;
+
+	DWORD numPairs = GetKerningPairsW(dc, 0, nullptr);
+	if(numPairs > 0) {
+		vector<KERNINGPAIR> gdiPairs(numPairs);
+		numPairs = GetKerningPairsW(dc, numPairs, gdiPairs.data());
+		vector<FontKerning::Pair> pairs;
+		for(uint i = 0; i < numPairs; i++) {
+			int amount = (int)std::lround(gdiPairs[i].iKernAmount / oversample);
+			if(amount != 0) pairs.push_back({gdiPairs[i].wFirst, gdiPairs[i].wSecond, amount});
+		}
+		font.page.kerning.build(std::move(pairs));
+	}
+
+	pages.resize(params.numPages);
+	for(auto& p : pages) {
+		p.packer.init({params.pageSize, params.pageSize});
+	}
+	vector<ubyte> empty((size_t)font.width * font.height, 0);
+	font.texture.init(device, {font.width, font.height}, DXGI_FORMAT::DXGI_FORMAT_R8_UNORM, 1, empty.data());
+
+	add(font, ' ');
+	font.page.setFallback(' ');
+}
+GlyphCache::~GlyphCache() {
+	release();
+}
+void GlyphCache::release() {
+	if(hfont) DeleteObject(hfont);
+	if(dc) DeleteDC(dc);
+	if(!ttfFilename.empty()) RemoveFontResourceExW(ttfFilename.c_str(), FR_PRIVATE, nullptr);
+	hfont = nullptr;
+	dc = nullptr;
+	ttfFilename.clear();
+}
+bool GlyphCache::prepare(Font& font, const string& text) {
+	if(batchDepth == 0) tick++;
+	bool ok = true;
+	utf8::forEach(text, [&](uint ch) {
+		auto it = glyphPages.find(ch);
+		if(it != glyphPages.end()) {
+			if(it->second < pages.size()) pages[it->second].lastUsed = tick;
+			return;
+		}
+		if(!add(font, ch)) ok = false;
+	});
+	return ok;
+}
+void GlyphCache::upload(Font& font, ComPtr<ID3D11DeviceContext> context) {
+	for(auto& u : uploads) {
+		font.texture.write(context, u.pos, u.size, u.data.data(), u.size.x);
+	}
+	uploads.clear();
+}
+bool GlyphCache::add(Font& font, uint ch) {
+	/// Control characters and astral codepoints use the fallback glyph
+	if(ch < 32 || ch > 0xffff) {
+		glyphPages[ch] = MISSING;
+		return true;
+	}
+	float oversample = (float)params.oversample;
+	const MAT2 identity = {{0, 1}, {0, 0}, {0, 0}, {0, 1}};
+	GLYPHMETRICS gm = {};
+	DWORD bytes = GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, 0, nullptr, &identity);
+	if(bytes != GDI_ERROR && bytes > 0) {
+		bitmap.resize(bytes);
+		bytes = GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, bytes, bitmap.data(), &identity);
+	}
+	if(bytes == GDI_ERROR) {
+		glyphPages[ch] = MISSING;
+		return true;
+	}
+	FontChar c = {};
+	c.id = ch;
+	c.xadvance = (uint)std::max(0L, std::lround(gm.gmCellIncX / oversample));
+
+	if(bytes == 0) {
+		/// Blank glyph (eg. ' ') which needs no atlas space
+		font.page.add(c);
+		font.measureCache.clear();
+		glyphPages[ch] = NO_PAGE;
+		rasterised++;
+		return true;
+	}
+
+	/// GGO_GRAY8_BITMAP rows are 4 byte aligned and have 65 levels (0..64)
+	uint pitch = (gm.gmBlackBoxX + 3) & ~3u;
+	uint2 sdfSize;
+	auto sdf = SDFGenerator::glyph(bitmap.data(), pitch, {gm.gmBlackBoxX, gm.gmBlackBoxY},
+								   1.0f / oversample, params.spread, 32, sdfSize);
+	uint pageIndex;
+	uint2 pos;
+	if(!allocate(font, sdfSize, pageIndex, pos)) return false;
+
+	uint2 atlasPos = {pos.x, pageIndex * params.pageSize + pos.y};
+	int spread = (int)params.spread;
+	c.width   = sdfSize.x;
+	c.height  = sdfSize.y;
+	c.xoffset = (int)std::lround(gm.gmptGlyphOrigin.x / oversample) - spread;
+	c.yoffset = (int)font.base - (int)std::lround(gm.gmptGlyphOrigin.y / oversample) - spread;
+	c.u  = (float)atlasPos.x / font.width;
+	c.v  = (float)atlasPos.y / font.height;
+	c.u2 = (float)(atlasPos.x + c.width - 1) / font.width;
+	c.v2 = (float)(atlasPos.y + c.height - 1) / font.height;
+	font.page.add(c);
+	/// Text measured before this glyph was added used the fallback glyph
+	font.measureCache.clear();
+
+	pages[pageIndex].glyphs.push_back(ch);
+	glyphPages[ch] = pageIndex;
+	uploads.push_back({atlasPos, sdfSize, std::move(sdf)});
+	rasterised++;
+	return true;
+}
+bool GlyphCache::allocate(Font& font, uint2 size, uint& pageIndex, uint2& pos) {
+	/// Leave a 1 pixel gap to the right and below
+	uint2 padded = {size.x + 1, size.y + 1};
+	if(padded.x > params.pageSize || padded.y > params.pageSize) return false;
+
+	for(uint i = 0; i < pages.size(); i++) {
+		if(pages[i].packer.insert(padded, pos)) {
+			pageIndex = i;
+			pages[i].lastUsed = tick;
+			return true;
+		}
+	}
+	/// Evict the least recently used page that this prepare() (or batch) has not touched
+	uint lru = NO_PAGE;
+	for(uint i = 0; i < pages.size(); i++) {
+		if(pages[i].lastUsed == tick) continue;
+		if(lru == NO_PAGE || pages[i].lastUsed < pages[lru].lastUsed) lru = i;
+	}
+	if(lru == NO_PAGE) return false;
+
+	evict(font, lru);
+	if(!pages[lru].packer.insert(padded, pos)) return false;
+	pageIndex = lru;
+	pages[lru].lastUsed = tick;
+	return true;
+}
+void GlyphCache::evict(Font& font, uint pageIndex) {
+	auto& page = pages[pageIndex];
+	for(auto ch : page.glyphs) {
+		font.page.remove(ch);
+		glyphPages.erase(ch);
+	}
+	page.glyphs.clear();
+	page.packer.clear();
+	font.measureCache.clear();
+
+	/// Clear the page so that stale texels cannot bleed into new glyphs
+	uploads.push_back({{0, pageIndex * params.pageSize}, {params.pageSize, params.pageSize},
+					   vector<ubyte>((size_t)params.pageSize * params.pageSize, 0)});
+	font.generation++;
+	evictions++;
+}
+
+} /// dx11
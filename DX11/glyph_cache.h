@@ -0,0 +1,79 @@
+#pragma once
+///
+///	Dynamic glyph atlas for fonts loaded from TrueType files.
+///
+///	Glyphs are rasterised with GDI on first use at _oversample_ times the font size, turned
+///	into a distance field by SDFGenerator and packed into the atlas with a skyline packer.
+///	Only the new glyph's rectangle is uploaded.
+///
+///	The atlas texture is a column of _numPages_ square pages. When no page has room the
+///	least recently used page is evicted as a whole: its glyphs are removed from the Font
+///	and Font::generation is incremented so that Text regenerates everything it has built.
+///	Pages used by the current prepare() call are never evicted so the atlas must be big
+///	enough for the glyphs of one chunk of text. Between beginBatch() and endBatch() every
+///	prepare() shares one tick, so a page used anywhere in the batch is not evicted until the
+///	batch ends. Glyphs that do not fit then use the fallback glyph and prepare() returns false.
+///
+///	GDI only rasterises the BMP. Codepoints above U+FFFF use the fallback glyph.
+///
+namespace dx11 {
+
+class Font;
+
+struct GlyphCacheParams final {
+	uint size = 32;			/// font size in pixels
+	uint spread = 4;		/// distance field range in pixels
+	uint oversample = 4;	/// rasterisation scale relative to _size_
+	uint pageSize = 512;
+	uint numPages = 4;
+};
+
+class GlyphCache final {
+	struct Page final {
+		SkylinePacker packer;
+		vector<uint> glyphs;	/// codepoints in this page
+		ulong lastUsed = 0;
+	};
+	struct Upload final {
+		uint2 pos, size;
+		vector<ubyte> data;
+	};
+	static constexpr uint NO_PAGE = 0xffffffff;		/// resident but takes no atlas space (eg. ' ')
+	static constexpr uint MISSING = 0xfffffffe;		/// could not be rasterised
+
+	GlyphCacheParams params;
+	wstring ttfFilename;
+	HDC dc = nullptr;
+	HFONT hfont = nullptr;
+	vector<Page> pages;
+	unordered_map<uint, uint> glyphPages;	/// codepoint -> page index, NO_PAGE or MISSING
+	vector<Upload> uploads;
+	vector<ubyte> bitmap;
+	ulong tick = 0;
+	uint batchDepth = 0;
+public:
+	ulong rasterised = 0, evictions = 0;
+
+	///	If _ttfFilename_ is empty _faceName_ must be an installed font
+	GlyphCache(Font& font, ComPtr<ID3D11Device> device, const wstring& ttfFilename, const wstring& faceName, const GlyphCacheParams& params);
+	~GlyphCache();
+	GlyphCache(const GlyphCache&) = delete;
+	GlyphCache& operator=(const GlyphCache&) = delete;
+
+	/// Make every glyph in _text_ resident. Returns false if some glyphs did not fit
+	bool prepare(Font& font, const string& text);
+	/// Batches nest. Only the outermost one starts a new tick
+	void beginBatch() { if(batchDepth++ == 0) tick++; }
+	void endBatch() { assert(batchDepth > 0); batchDepth--; }
+	/// Upload the glyphs added since the last call
+	void upload(Font& font, ComPtr<ID3D11DeviceContext> context);
+	uint numResident() const { return (uint)glyphPages.size(); }
+	bool hasUploads() const { return !uploads.empty(); }
+private:
+	void release();
+	bool add(Font& font, uint ch);
+	bool allocate(Font& font, uint2 size, uint& pageIndex, uint2& pos);
+	void evict(Font& font, uint pageIndex);
+};
+
+} /// dx11
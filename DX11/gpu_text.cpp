@@ -0,0 +1,359 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+GpuText& GpuText::init(DX11& dx11, Font* font, bool dropShadow, uint maxCharacters, uint maxChunks) {
+	if(maxChunks > MAX_CHUNKS) throw std::runtime_error("GpuText supports at most 65535 chunks");
+	this->font = font;
+	this->dropShadow = dropShadow;
+	this->maxCharacters = maxCharacters;
+	this->maxChunks = maxChunks;
+	this->size = (float)font->size;
+	constantBuffer.data.dropShadowEnabled = dropShadow ? 1.0f : 0.0f;
+	codepoints.assign(maxCharacters, 0);
+
+	setupPipeline(dx11);
+	isInitialised = true;
+	return *this;
+}
+GpuText& GpuText::appendText(const string& text, float x, float y) {
+	assert(chunks.size() < maxChunks);
+	Chunk c = {};
+	c.origin = {x, y};
+	c.size = size;
+	c.colour = colour.toRGBA8();
+	chunks.push_back(c);
+	capacities.push_back(0);
+	texts.push_back(text);
+	decode((uint)chunks.size() - 1, text);
+	return *this;
+}
+GpuText& GpuText::replaceText(uint index, const string& text) {
+	assert(index < chunks.size());
+	texts[index] = text;
+	decode(index, text);
+	return *this;
+}
+GpuText& GpuText::clear() {
+	chunks.clear();
+	capacities.clear();
+	texts.clear();
+	codepointUploads.clear();
+	chunkUploads.clear();
+	numSlots = 0;
+	repackRequired = false;
+	layoutRequired = true;
+	return *this;
+}
+void GpuText::update(const FrameResource& frame) {
+	assert(isInitialised && cameraSet);
+	auto context = frame.context;
+
+	if(constantsChanged) {
+		constantBuffer.write(context);
+		constantsChanged = false;
+	}
+	if(repackRequired) repack();
+
+	if(font->isDynamic()) prepareGlyphs(frame);
+	if(font->generation != fontGeneration || font->page.count() != fontGlyphs) tablesChanged = true;
+	if(tablesChanged) updateTables(frame);
+
+	if(!codepointUploads.empty() || !chunkUploads.empty()) {
+		uploadRanges(context);
+		layoutRequired = true;
+	}
+	if(layoutRequired) dispatch(context);
+}
+void GpuText::render(const FrameResource& frame) {
+	assert(isInitialised && cameraSet);
+	if(chunks.empty()) return;
+
+	auto context = frame.context;
+
+	/// Glyphs are expanded from the instance buffer using SV_VertexID and SV_InstanceID
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	context->VSSetShader(vertexShader, nullptr, 0);
+	context->VSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
+	context->VSSetShaderResources(1, 1, instanceBuffer.srv.GetAddressOf());
+
+	context->PSSetSamplers(0, 1, sampler.GetAddressOf());
+	context->PSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
+	context->PSSetShaderResources(0, 1, font->texture.srv.GetAddressOf());
+	context->PSSetShader(dropShadow ? combinedPixelShader : pixelShader, nullptr, 0);
+	context->OMSetBlendState(blendState.Get(), nullptr, 0xffffffff);
+
+	context->DrawInstancedIndirect(drawArgs.handle.Get(), 0);
+
+	/// Unset our srvs so that the next layout pass can write the instances
+	ID3D11ShaderResourceView* nullsrvs[] = {nullptr};
+	context->VSSetShaderResources(1, 1, nullsrvs);
+	context->PSSetShaderResources(0, 1, nullsrvs);
+}
+void GpuText::readback(ComPtr<ID3D11DeviceContext> context, vector<GlyphInstance>& out) {
+	ComPtr<ID3D11Device> device;
+	context->GetDevice(device.GetAddressOf());
+	if(!instanceStaging.handle) {
+		instanceStaging.init(device, maxCharacters);
+		argsStaging.init(device, 4);
+	}
+	uint args[4];
+	context->CopyResource(argsStaging.handle.Get(), drawArgs.handle.Get());
+	argsStaging.read(context, args);
+
+	out.resize(maxCharacters);
+	context->CopyResource(instanceStaging.handle.Get(), instanceBuffer.handle.Get());
+	instanceStaging.read(context, out.data());
+	out.resize(std::min(args[1], maxCharacters));
+}
+void GpuText::layoutCPU(vector<GlyphInstance>& out) const {
+	layoutCPU(*font, chunks, codepoints.data(), out);
+}
+void GpuText::layoutCPU(const Font& font, const vector<Chunk>& chunks, const uint* codepoints, vector<GlyphInstance>& out) {
+	out.clear();
+	bool kern = font.hasKerning();
+	for(auto& c : chunks) {
+		float X = c.origin.x;
+		float ratio = c.size / (float)font.size;
+		const uint* text = codepoints + c.firstCodepoint;
+
+		for(uint i = 0; i < c.numCodepoints; i++) {
+			uint ch = text[i];
+			auto& g = font.getChar(ch);
+
+			if(kern && i > 0) {
+				X += font.getKerning(text[i - 1], ch) * ratio;
+			}
+			if(g.width > 0 && g.height > 0) {
+				float x = X + g.xoffset * ratio;
+				float y = c.origin.y + g.yoffset * ratio;
+				out.push_back({{x, y}, {g.width * ratio, g.height * ratio},
+							   {toUnorm16(g.u), toUnorm16(g.v), toUnorm16(g.u2), toUnorm16(g.v2)},
+							   c.colour, c.size});
+			}
+			X += g.xadvance * ratio;
+		}
+	}
+}
+uint GpuText::compare(vector<GlyphInstance> a, vector<GlyphInstance> b, float epsilon) {
+	const auto same = [epsilon](const GlyphInstance& x, const GlyphInstance& y) {
+		return std::abs(x.pos.x - y.pos.x) <= epsilon &&
+			   std::abs(x.pos.y - y.pos.y) <= epsilon &&
+			   std::abs(x.dimension.x - y.dimension.x) <= epsilon &&
+			   std::abs(x.dimension.y - y.dimension.y) <= epsilon &&
+			   memcmp(x.uv, y.uv, sizeof(x.uv)) == 0 &&
+			   x.colour == y.colour &&
+			   x.size == y.size;
+	};
+	/// Match each instance of _a_ with an unused instance of _b_ within _epsilon_ in x
+	std::sort(b.begin(), b.end(), [](const GlyphInstance& x, const GlyphInstance& y) { return x.pos.x < y.pos.x; });
+	vector<bool> used(b.size(), false);
+	uint matched = 0;
+	for(auto& g : a) {
+		auto it = std::lower_bound(b.begin(), b.end(), g.pos.x - epsilon, [](const GlyphInstance& x, float v) { return x.pos.x < v; });
+		for(; it != b.end() && it->pos.x <= g.pos.x + epsilon; ++it) {
+			size_t i = it - b.begin();
+			if(!used[i] && same(g, *it)) {
+				used[i] = true;
+				matched++;
+				break;
+			}
+		}
+	}
+	return (uint)(a.size() - matched + b.size() - matched);
+}
+void GpuText::setupPipeline(DX11& dx11) {
+	auto device = dx11.device;
+	chunkBuffer.init(device, maxChunks);
+	codepointBuffer.init(device, maxCharacters);
+	instanceBuffer.init(device, maxCharacters);
+
+	/// VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation
+	const uint initialArgs[4] = {6, 0, 0, 0};
+	drawArgs.init(device, 4, initialArgs);
+
+	layoutConstants.init(device);
+	constantBuffer.init(device);
+
+	ShaderArgs args{};
+	layoutShader = dx11.shaders.makeCS(dx11.params.shadersDirectory + L"text_layout.hlsl", args);
+	args.entry("VSMainGpu");
+	vertexShader = dx11.shaders.makeVS(dx11.params.shadersDirectory + L"text.hlsl", args);
+	args.entry("PSMain");
+	pixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
+	args.entry("PSMainCombined");
+	combinedPixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
+
+	Text::createStates(device, sampler, blendState);
+}
+/// Decode _text_ into the slots of chunk _index_, moving the chunk if it has outgrown them
+void GpuText::decode(uint index, const string& text) {
+	uint count = utf8::count(text);
+	auto& c = chunks[index];
+	if(count > capacities[index] && !allocate(index, count)) {
+		/// No room at the end. Everything is compacted in update()
+		c.numCodepoints = count;
+		repackRequired = true;
+		return;
+	}
+	uint* dest = codepoints.data() + c.firstCodepoint;
+	uint i = 0;
+	utf8::forEach(text, [&](uint ch) { dest[i++] = ch; });
+	c.numCodepoints = count;
+
+	if(!repackRequired) {
+		codepointUploads.push_back({c.firstCodepoint, count});
+		chunkUploads.push_back({index, 1});
+	}
+}
+bool GpuText::allocate(uint index, uint count) {
+	uint capacity = withSlack(count);
+	auto& c = chunks[index];
+	if(capacities[index] > 0 && c.firstCodepoint + capacities[index] == numSlots) {
+		/// Last chunk. Grow in place
+		if(c.firstCodepoint + capacity > maxCharacters) return false;
+		numSlots = c.firstCodepoint + capacity;
+	} else {
+		if(numSlots + capacity > maxCharacters) return false;
+		c.firstCodepoint = numSlots;
+		numSlots += capacity;
+	}
+	capacities[index] = capacity;
+	return true;
+}
+/// Reassign all slot ranges contiguously and decode every chunk again
+void GpuText::repack() {
+	repackRequired = false;
+	uint total = 0, totalWithSlack = 0;
+	for(auto& c : chunks) {
+		total += c.numCodepoints;
+		totalWithSlack += withSlack(c.numCodepoints);
+	}
+	if(total > maxCharacters) throw std::runtime_error("GpuText: maxCharacters exceeded");
+	bool slack = totalWithSlack <= maxCharacters;
+
+	numSlots = 0;
+	codepointUploads.clear();
+	chunkUploads.clear();
+	for(uint i = 0; i < chunks.size(); i++) {
+		chunks[i].firstCodepoint = numSlots;
+		capacities[i] = slack ? withSlack(chunks[i].numCodepoints) : chunks[i].numCodepoints;
+		numSlots += capacities[i];
+
+		uint* dest = codepoints.data() + chunks[i].firstCodepoint;
+		uint n = 0;
+		utf8::forEach(texts[i], [&](uint ch) { dest[n++] = ch; });
+	}
+	if(numSlots > 0) codepointUploads.push_back({0, numSlots});
+	if(!chunks.empty()) chunkUploads.push_back({0, (uint)chunks.size()});
+}
+/// Dynamic fonts only know the glyphs that have been prepared. If glyphs were evicted, before
+/// or while preparing the changed chunks, every chunk has to be prepared again
+void GpuText::prepareGlyphs(const FrameResource& frame) {
+	bool ok = true;
+	font->beginPrepare();
+	bool all = font->generation != fontGeneration;
+	if(!all) {
+		uint generation = font->generation;
+		for(auto& r : chunkUploads) {
+			for(uint i = r.start; i < r.start + r.count; i++) ok &= font->prepare(texts[i]);
+		}
+		all = font->generation != generation;
+	}
+	if(all) {
+		ok = true;
+		for(auto& t : texts) ok &= font->prepare(t);
+	}
+	font->endPrepare();
+	if(!ok) Log::format("GpuText: the atlas of %s is too small. Some glyphs use the fallback glyph", WString::toString(font->name).c_str());
+	font->updateAtlas(frame.context);
+}
+/// Upload the glyph metrics and kerning pairs sorted by codepoint for the binary searches
+/// in text_layout.hlsl. The fallback glyph goes at the end
+void GpuText::updateTables(const FrameResource& frame) {
+	tablesChanged = false;
+	fontGeneration = font->generation;
+	fontGlyphs = font->page.count();
+
+	vector<FontChar> chars = font->page.all();
+	std::sort(chars.begin(), chars.end(), [](const FontChar& a, const FontChar& b) { return a.id < b.id; });
+	chars.push_back(font->getChar(0x110000));
+
+	vector<uint> ids(chars.size());
+	vector<Glyph> glyphs(chars.size());
+	for(uint i = 0; i < chars.size(); i++) {
+		auto& c = chars[i];
+		ids[i] = c.id;
+		glyphs[i] = {{c.u, c.v, c.u2, c.v2}, {(float)c.xoffset, (float)c.yoffset},
+					 {(float)c.width, (float)c.height}, (float)c.xadvance};
+	}
+	auto& pairs = font->page.kerning.all();
+
+	/// Grow the buffers in powers of 2 as dynamic fonts add glyphs
+	if(glyphs.size() > glyphCapacity) {
+		glyphCapacity = std::bit_ceil((uint)glyphs.size());
+		glyphIdBuffer.init(frame.device, glyphCapacity);
+		glyphBuffer.init(frame.device, glyphCapacity);
+	}
+	if(pairs.size() > kerningCapacity || kerningCapacity == 0) {
+		kerningCapacity = std::bit_ceil(std::max(1u, (uint)pairs.size()));
+		kerningBuffer.init(frame.device, kerningCapacity);
+	}
+	glyphIdBuffer.write(frame.context, ids.data(), 0, (uint)ids.size());
+	glyphBuffer.write(frame.context, glyphs.data(), 0, (uint)glyphs.size());
+	if(!pairs.empty()) kerningBuffer.write(frame.context, pairs.data(), 0, (uint)pairs.size());
+
+	layoutConstants.data.numGlyphs = (uint)chars.size() - 1;
+	layoutConstants.data.numKerningPairs = font->hasKerning() ? (uint)pairs.size() : 0;
+	layoutConstants.data.fontSize = (float)font->size;
+	layoutRequired = true;
+}
+void GpuText::uploadRanges(ComPtr<ID3D11DeviceContext> context) {
+	mergeSlotRanges(codepointUploads);
+	for(auto& r : codepointUploads) {
+		if(r.count > 0) codepointBuffer.write(context, codepoints.data() + r.start, r.start, r.count);
+	}
+	mergeSlotRanges(chunkUploads);
+	for(auto& r : chunkUploads) {
+		chunkBuffer.write(context, chunks.data() + r.start, r.start, r.count);
+	}
+	codepointUploads.clear();
+	chunkUploads.clear();
+}
+void GpuText::dispatch(ComPtr<ID3D11DeviceContext> context) {
+	layoutRequired = false;
+
+	/// Reset the instance count. The layout pass adds to it
+	const uint args[4] = {6, 0, 0, 0};
+	drawArgs.write(context, args);
+	if(chunks.empty()) return;
+
+	layoutConstants.data.numChunks = (uint)chunks.size();
+	layoutConstants.write(context);
+
+	ID3D11ShaderResourceView* srvs[] = {
+		chunkBuffer.view.Get(), codepointBuffer.view.Get(), glyphIdBuffer.view.Get(),
+		glyphBuffer.view.Get(), kerningBuffer.view.Get()
+	};
+	ID3D11UnorderedAccessView* uavs[] = {instanceBuffer.uav.Get(), drawArgs.uav.Get()};
+
+	context->CSSetShader(layoutShader, nullptr, 0);
+	context->CSSetConstantBuffers(0, 1, layoutConstants.handle.GetAddressOf());
+	context->CSSetShaderResources(0, 5, srvs);
+	context->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+
+	context->Dispatch((uint)chunks.size(), 1, 1);
+
+	ID3D11ShaderResourceView* nullsrvs[5] = {};
+	ID3D11UnorderedAccessView* nulluavs[2] = {};
+	context->CSSetShaderResources(0, 5, nullsrvs);
+	context->CSSetUnorderedAccessViews(0, 2, nulluavs, nullptr);
+	context->CSSetShader(nullptr, nullptr, 0);
+}
+
+} /// dx11
@@ -0,0 +1,146 @@
+#pragma once
+///
+///	SDF text laid out on the GPU.
+///
+///	Only the codepoints of each chunk and a small per-chunk record (origin, size, colour)
+///	are uploaded. The font's glyph metrics and kerning pairs live in GPU buffers and a
+///	compute pass (text_layout.hlsl) accumulates the advances and writes one instance per
+///	visible glyph, followed by a DrawInstancedIndirect. Changing a line of a large log only
+///	uploads that line's codepoints.
+///
+///	Each chunk owns a range of codepoint slots with some slack, the same scheme Text uses
+///	for its glyph slots. The layout matches Text::appendText: a single line per chunk with
+///	the pen at the top left.
+///
+///	layoutCPU() produces the same instances on the CPU. Instances from different chunks
+///	and tiles are written in an undefined order so compare() matches them up before diffing.
+///
+namespace dx11 {
+
+class GpuText final {
+public:
+	/// The layout pass writes the instances Text draws
+	using GlyphInstance = Text::GlyphInstance;
+	struct Chunk final {
+		float2 origin;
+		float size;
+		uint colour;
+		uint firstCodepoint;
+		uint numCodepoints;
+		uint _pad[2];
+	}; static_assert(8 * 4 == sizeof(Chunk));
+private:
+	struct Glyph final {
+		float4 uv;
+		float2 offset;
+		float2 dimension;
+		float advance;
+		float _pad[3];
+	}; static_assert(12 * 4 == sizeof(Glyph));
+	struct LayoutConstants final {
+		uint numChunks;
+		uint numGlyphs;
+		uint numKerningPairs;
+		float fontSize;
+	}; static_assert(4 * 4 == sizeof(LayoutConstants));
+	using Constants = Text::Constants;
+	static constexpr uint GROUP_SIZE = 256;		/// text_layout.hlsl
+	static constexpr uint MAX_CHUNKS = 65535;	/// one thread group per chunk
+
+	Font* font = nullptr;
+	uint maxCharacters = 0, maxChunks = 0;
+	float size = 0;
+	rgba colour = rgba{1, 1, 1, 1};
+	bool dropShadow = false;
+	bool isInitialised = false, cameraSet = false;
+
+	vector<Chunk> chunks;
+	vector<uint> capacities;		/// codepoint slots owned by each chunk
+	vector<string> texts;			/// kept for dynamic fonts which need prepare()
+	vector<uint> codepoints;		/// CPU copy of the codepoint buffer
+	uint numSlots = 0;
+	vector<SlotRange> codepointUploads, chunkUploads;
+
+	uint fontGeneration = 0, fontGlyphs = 0;
+	bool tablesChanged = true, repackRequired = false, layoutRequired = true, constantsChanged = true;
+	uint glyphCapacity = 0, kerningCapacity = 0;
+
+	StructuredBuffer<Chunk> chunkBuffer;
+	ByteAddressBuffer codepointBuffer;
+	StructuredBuffer<uint> glyphIdBuffer;
+	StructuredBuffer<Glyph> glyphBuffer;
+	StructuredBuffer<FontKerning::Pair> kerningBuffer;
+	RWStructuredBuffer<GlyphInstance> instanceBuffer;
+	IndirectArgsBuffer drawArgs;
+	ConstantBuffer<LayoutConstants> layoutConstants;
+	ConstantBuffer<Constants> constantBuffer;
+	StagingReadBuffer<GlyphInstance> instanceStaging;
+	StagingReadBuffer<uint> argsStaging;
+
+	ComputeShader layoutShader = {};
+	VertexShader vertexShader = {};
+	PixelShader pixelShader = {}, combinedPixelShader = {};
+	ComPtr<ID3D11SamplerState> sampler;
+	ComPtr<ID3D11BlendState> blendState;
+public:
+	GpuText& init(DX11& dx11, Font* font, bool dropShadow, uint maxCharacters, uint maxChunks = 4096);
+
+	GpuText& camera(Camera& cam) {
+		constantBuffer.data.viewProj = cam.VP();
+		cameraSet = true;
+		constantsChanged = true;
+		return *this;
+	}
+	GpuText& setColour(rgba colour) {
+		this->colour = colour;
+		return *this;
+	}
+	GpuText& setSize(float size) {
+		this->size = size;
+		return *this;
+	}
+	GpuText& setDropShadowColour(rgba c) {
+		constantBuffer.data.dropShadowColour = c;
+		constantsChanged = true;
+		return *this;
+	}
+	GpuText& setDropShadowOffset(float2 o) {
+		constantBuffer.data.dropShadowOffset = o;
+		constantsChanged = true;
+		return *this;
+	}
+	GpuText& appendText(const string& text, float x = 0, float y = 0);
+	/// Only the codepoints of the replaced chunk are uploaded
+	GpuText& replaceText(uint index, const string& text);
+	GpuText& clear();
+
+	uint numChunks() const { return (uint)chunks.size(); }
+
+	/// Upload changes and run the layout pass if anything has changed
+	void update(const FrameResource& frame);
+	void render(const FrameResource& frame);
+
+	/// Read back the instances written by the last layout pass. Stalls the pipeline
+	void readback(ComPtr<ID3D11DeviceContext> context, vector<GlyphInstance>& out);
+	/// Lay out the current chunks on the CPU
+	void layoutCPU(vector<GlyphInstance>& out) const;
+	/// Reference implementation of text_layout.hlsl. Instances are in chunk order
+	static void layoutCPU(const Font& font, const vector<Chunk>& chunks, const uint* codepoints, vector<GlyphInstance>& out);
+	/// Returns the number of instances in _a_ or _b_ that have no match in the other list.
+	/// Positions may differ by up to _epsilon_ because the GPU sums the advances in a different order
+	static uint compare(vector<GlyphInstance> a, vector<GlyphInstance> b, float epsilon = 0.01f);
+private:
+	void setupPipeline(DX11& dx11);
+	void decode(uint index, const string& text);
+	bool allocate(uint index, uint count);
+	void repack();
+	void prepareGlyphs(const FrameResource& frame);
+	void updateTables(const FrameResource& frame);
+	void uploadRanges(ComPtr<ID3D11DeviceContext> context);
+	void dispatch(ComPtr<ID3D11DeviceContext> context);
+	static uint withSlack(uint count) {
+		return count + std::max(4u, count / 4);
+	}
+};
+
+} /// dx11
@@ -0,0 +1,57 @@
+#pragma once
+///
+///	Read-only memory mapped view of a whole file.
+///
+namespace dx11 {
+
+class MappedFile final {
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	const ubyte* _data = nullptr;
+	ulong _size = 0;
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	/// Returns false if the file does not exist or cannot be mapped
+	bool open(const wstring& filename) {
+		close();
+		file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+						   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size = {};
+		if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(!mapping) {
+			close();
+			return false;
+		}
+		_data = (const ubyte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if(!_data) {
+			close();
+			return false;
+		}
+		_size = (ulong)size.QuadPart;
+		return true;
+	}
+	void close() {
+		if(_data) UnmapViewOfFile(_data);
+		if(mapping) CloseHandle(mapping);
+		if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		_data = nullptr;
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+		_size = 0;
+	}
+	const ubyte* data() const { return _data; }
+	ulong size() const { return _size; }
+	bool isOpen() const { return _data != nullptr; }
+};
+
+} /// dx11
@@ -1,55 +1,275 @@
 #pragma once
 ///
-///	Display textured quads.
+///	Display textured quads (sprites).
+///
+///	Each quad has its own texture, uv rectangle and rotation. Quads are bucketed by texture
+///	when they are uploaded so there is one draw call per texture however the quads were
+///	added. Quads with the same texture are drawn in the order they were added.
+///
+///	With enableAnimation() each quad also gets an AnimationVertex which the vertex shader
+///	evaluates against the frame time, so animated quads are not uploaded every frame.
+///
+///	quad() returns a handle which stays valid until the quad is removed. Moving, recolouring or
+///	removing a quad through its handle only rewrites that quad's slot in the buffers. Removed
+///	slots are reused by quads with the same texture and are compacted away on the next full
+///	rebuild (adding a quad when no slot can be reused, or when over half the slots are free).
+///
+///	With enableSpatialIndex() the quads are also kept in a QuadGrid, updated as they move.
+///	Then setCullRect() uploads and draws only the quads overlapping the rect, packed together
+///	at the start of the buffers. Changing a quad that is already in the buffers only rewrites
+///	its slot. The grid is queried again when the rect changes or a quad that was left out
+///	moves into it. Culling uses the positions before any animated movement.
+///
+///	Instanced quads upload their 32 byte Info as is and the vertex shader expands the corners
+///	from SV_VertexID, instead of the CPU writing 6 vertices (120 bytes) per quad.
+///
+///	Otherwise the vertices are written 4 quads at a time with SSE. Big rebuilds are split
+///	across a thread pool, each task writing its own range of the CPU buffers. prepare() does the
+///	CPU side of a rebuild ahead of update().
 ///
 namespace dx11 {
 
+struct QuadHandle final {
+	uint id = 0xffffffff;
+	uint generation = 0;
+};
+
 class Quad {
+	/// Also the per instance data when instanced. Matches VSInstanceInput in quad.hlsl
 	struct Info final {
 		float2 pos;
 		float2 size;
-		rgba color;
-	};
+		ushort uv[4];	/// u, v, u2, v2 (unorm16)
+		uint color;		/// rgba8
+		float rotation;	/// radians about the centre
+	}; static_assert(8*4==sizeof(Info));
 	struct Vertex final {
 		float2 pos;
-		rgba color;
+		uint color;		/// rgba8
 		float2 uv;
-	}; static_assert(8*4==sizeof(Vertex));
+	}; static_assert(5*4==sizeof(Vertex));
 	struct Constants final {
 		matrix viewProj;
-	}; static_assert(16 * 4 == sizeof(Constants) && sizeof(Constants) % 16 == 0);
+		float time = 0;	/// seconds, animated only
+		float _pad[3];
+	}; static_assert(20 * 4 == sizeof(Constants) && sizeof(Constants) % 16 == 0);
+	/// Quads [start, start + count) of the upload use textures[texture]
+	struct Batch final {
+		uint texture;
+		uint start, count;
+	};
+	struct Handle final {
+		uint slot;				/// NONE if free
+		uint generation;
+	};
+	static constexpr uint NONE = 0xffffffff;
+	/// Compact when at least this many slots, and over half of them, are free
+	static constexpr uint MIN_COMPACT = 64;
+	/// Smallest range of quads given to a thread pool task
+	static constexpr uint QUADS_PER_TASK = 16 * 1024;
 
 	ComPtr<ID3D11InputLayout> inputLayout;
-	ComPtr<ID3D11ShaderResourceView> _texture;
 	ComPtr<ID3D11SamplerState> _sampler;
+	vector<ComPtr<ID3D11ShaderResourceView>> textures;
 	VertexBuffer<Vertex> vertexBuffer;
+	VertexBuffer<Info> instanceBuffer;
+	VertexBuffer<AnimationVertex> animationBuffer;
 	ConstantBuffer<Constants> constantBuffer;
 	VertexShader vertexShader = {};
 	PixelShader pixelShader = {};
+	/// Indexed by slot. Free slots hold a zero sized quad
 	vector<Info> quads;
+	vector<ushort> quadTextures;			/// index into textures
+	vector<AnimationVertex> animations;
+	vector<uint> slotHandles;				/// handle id, NONE if the slot is free
+
+	vector<Handle> handles;
+	vector<uint> freeHandles;
+	vector<vector<uint>> freeSlots;			/// by texture
+	uint numFree = 0;
+
+	QuadGrid grid;
+	vector<uint> visibleSlots;				/// slots to upload, in slot order
+	Rect cullRect = {};
+	QuadCullStats stats = {};
+
+	vector<Batch> batches;
+	vector<uint> order;						/// buffer position -> slot. Sorted by texture
+	vector<uint> positions;					/// slot -> buffer position. NONE if not uploaded
+	vector<SlotRange> uploadRanges;			/// buffer positions changed since the last upload
+	/// CPU copies of the buffers. The instance buffers are written straight from quads and
+	/// animations if the quads did not need sorting
+	vector<Info> sortedQuads;
+	vector<Vertex> vertices;				/// 6 per quad
+	vector<AnimationVertex> animationVertices;
 	rgba _color = rgba(1,1,1,1);
-	uint maxVertices;
+	ushort uvRect[4] = {0, 0, 0xffff, 0xffff};
+	uint currentTexture = 0;
+	ThreadPool* pool = nullptr;
+	Animation _animation = {};
+	uint revealIndex = 0;	/// quads added since animation() was called
+	float time = 0;			/// frame time of the last update in seconds
+	uint maxQuads;
+	bool instanced = false;
+	bool sorted = false;					/// buffer positions are not slots
+	bool indexed = false;
+	bool culling = false;
+	bool visibleChanged = false;
+	bool uploadPending = false;				/// prepare() has been called since the last update
 	bool pipelineChanged = true;
 	bool constantsChanged = true;
 	bool cameraSet = false;
+	bool animated = false;
 	bool isInitialised = false;
 public:
-	Quad& init(DX11& dx11, uint maxQuads) {
-		this->maxVertices = maxQuads*6;
+	/// If _instanced_ is true each quad is uploaded as a single 32 byte instance
+	Quad& init(DX11& dx11, uint maxQuads, bool instanced = false) {
+		this->maxQuads = maxQuads;
+		this->instanced = instanced;
+		this->pool = &dx11.threads;
 		setupPipeline(dx11);
 		isInitialised = true;
 		return *this;
 	}
-	Quad& quad(float2 pos, float2 size) {
-		quads.push_back({pos, size, _color});
-		pipelineChanged = true;
+	/// _rotation_ is in radians, clockwise about the centre of the quad
+	Quad& quad(float2 pos, float2 size, float rotation = 0) {
+		add(pos, size, rotation);
+		return *this;
+	}
+	QuadHandle add(float2 pos, float2 size, float rotation = 0) {
+		Info info = {pos, size, {uvRect[0], uvRect[1], uvRect[2], uvRect[3]}, _color.toRGBA8(), rotation};
+		uint texture = currentTexture;
+		uint slot;
+		if(texture < freeSlots.size() && !freeSlots[texture].empty()) {
+			/// Same texture so the slot's buffer position is still in the right batch
+			slot = freeSlots[texture].back();
+			freeSlots[texture].pop_back();
+			numFree--;
+			quads[slot] = info;
+			if(animated) animations[slot] = AnimationVertex::make(_animation, time + _animation.delay, revealIndex++);
+			if(indexed) addToGrid(slot);
+			changed(slot);
+		} else {
+			if(quads.size() == maxQuads && numFree > 0) compact();
+			assert(quads.size() < maxQuads);
+			slot = (uint)quads.size();
+			quads.push_back(info);
+			quadTextures.push_back((ushort)texture);
+			slotHandles.push_back(NONE);
+			if(animated) animations.push_back(AnimationVertex::make(_animation, time + _animation.delay, revealIndex++));
+			if(indexed) addToGrid(slot);
+			pipelineChanged = true;
+		}
+		return allocateHandle(slot);
+	}
+	/// The quad's slot is cleared and reused later
+	Quad& remove(QuadHandle handle) {
+		uint slot = find(handle);
+		if(slot == NONE) return *this;
+		quads[slot] = {};
+		uint texture = quadTextures[slot];
+		if(freeSlots.size() <= texture) freeSlots.resize(texture + 1);
+		freeSlots[texture].push_back(slot);
+		numFree++;
+
+		auto& h = handles[slotHandles[slot]];
+		h.slot = NONE;
+		h.generation++;
+		freeHandles.push_back(slotHandles[slot]);
+		slotHandles[slot] = NONE;
+		if(indexed) grid.remove(slot);
+
+		changed(slot);
+		if(numFree >= MIN_COMPACT && numFree * 2 > quads.size()) pipelineChanged = true;
 		return *this;
 	}
+	Quad& move(QuadHandle handle, float2 pos) {
+		return modify(handle, [&](Info& q) { q.pos = pos; });
+	}
+	Quad& resize(QuadHandle handle, float2 size) {
+		return modify(handle, [&](Info& q) { q.size = size; });
+	}
+	Quad& setColor(QuadHandle handle, rgba color) {
+		return modify(handle, [&](Info& q) { q.color = color.toRGBA8(); });
+	}
+	Quad& setRotation(QuadHandle handle, float rotation) {
+		return modify(handle, [&](Info& q) { q.rotation = rotation; });
+	}
+	Quad& setUv(QuadHandle handle, float4 rect) {
+		return modify(handle, [&](Info& q) {
+			q.uv[0] = toUnorm16(rect.x);
+			q.uv[1] = toUnorm16(rect.y);
+			q.uv[2] = toUnorm16(rect.z);
+			q.uv[3] = toUnorm16(rect.w);
+		});
+	}
+	bool contains(QuadHandle handle) const { return find(handle) != NONE; }
+	uint numQuads() const { return (uint)quads.size() - numFree; }
+	/// Invalidates every handle
 	Quad& clear() {
+		for(uint slot = 0; slot < slotHandles.size(); slot++) {
+			uint id = slotHandles[slot];
+			if(id == NONE) continue;
+			handles[id].slot = NONE;
+			handles[id].generation++;
+			freeHandles.push_back(id);
+		}
 		quads.clear();
+		quadTextures.clear();
+		animations.clear();
+		slotHandles.clear();
+		freeSlots.clear();
+		numFree = 0;
+		grid.clear();
 		pipelineChanged = true;
 		return *this;
 	}
+	/// Keep the quads in a grid of _cellSize_ cells so that setCullRect() can find the visible
+	/// ones without looking at every quad
+	Quad& enableSpatialIndex(float cellSize = 256) {
+		grid.init(cellSize);
+		indexed = true;
+		for(uint slot = 0; slot < quads.size(); slot++) {
+			if(slotHandles[slot] != NONE) addToGrid(slot);
+		}
+		pipelineChanged = true;
+		return *this;
+	}
+	/// Only upload and draw the quads that overlap _visible_, which is in the same space as
+	/// the quad positions (eg. the area the 2D camera can see). Needs enableSpatialIndex()
+	Quad& setCullRect(Rect visible) {
+		assert(indexed);
+		if(!culling || memcmp(&visible, &cullRect, sizeof(Rect)) != 0) {
+			cullRect = visible;
+			culling = true;
+			visibleChanged = true;
+		}
+		return *this;
+	}
+	Quad& disableCulling() {
+		if(culling) {
+			culling = false;
+			visibleChanged = true;
+		}
+		return *this;
+	}
+	const QuadCullStats& cullStats() const { return stats; }
+	/// The pool that big rebuilds are split across. nullptr generates everything on the calling
+	/// thread. The default is DX11::threads
+	Quad& threads(ThreadPool* pool) {
+		this->pool = pool;
+		return *this;
+	}
+	///	Do the CPU side of a full rebuild now: compact, cull, sort by texture and write the
+	///	vertices. The next update() only uploads them
+	Quad& prepare() {
+		assert(isInitialised);
+		rebuild();
+		pipelineChanged = false;
+		visibleChanged = false;
+		uploadPending = true;
+		return *this;
+	}
 	Quad& camera(Camera& cam) {
 		constantBuffer.data.viewProj = cam.VP();
 		cameraSet = true;
@@ -60,21 +280,63 @@ public:
 		_color = color;
 		return *this;
 	}
+	/// The part of the texture used by quads added after this (eg. a sprite in an atlas).
+	/// u, v, u2, v2 in 0..1. The default is the whole texture
+	Quad& uv(float4 rect) {
+		uvRect[0] = toUnorm16(rect.x);
+		uvRect[1] = toUnorm16(rect.y);
+		uvRect[2] = toUnorm16(rect.z);
+		uvRect[3] = toUnorm16(rect.w);
+		return *this;
+	}
+	/// Adds a per quad animation stream. Call before init()
+	Quad& enableAnimation() {
+		assert(!isInitialised);
+		animated = true;
+		return *this;
+	}
+	/// The animation given to quads added after this. Animation{} is no animation.
+	/// Quads are revealed in the order they are added
+	Quad& animation(const Animation& animation) {
+		assert(animated);
+		_animation = animation;
+		revealIndex = 0;
+		return *this;
+	}
 	Quad& sampler(ComPtr<ID3D11SamplerState> sampler) {
 		_sampler = sampler;
 		return *this;
 	}
+	/// The texture of quads added after this. Quads added before the first call use the
+	/// first texture
 	Quad& texture(ComPtr<ID3D11ShaderResourceView> texture) {
-		_texture = texture;
+		uint i = 0;
+		while(i < textures.size() && textures[i].Get() != texture.Get()) i++;
+		if(i == textures.size()) {
+			assert(i < 0xffff);
+			textures.push_back(texture);
+			/// The batches refer to textures by index
+			pipelineChanged = true;
+		}
+		currentTexture = i;
 		return *this;
 	}
+	uint numDrawCalls() const { return (uint)batches.size(); }
+
 	void update(const FrameResource& frame) {
 		assert(isInitialised && cameraSet);
+		if(animated) {
+			time = AnimationVertex::time(frame);
+			constantBuffer.data.time = time;
+			constantsChanged = true;
+		}
 		if(constantsChanged) {
 			updateConstants(frame);
 		}
-		if(pipelineChanged) {
+		if(pipelineChanged || visibleChanged) {
 			updatePipeline(frame);
+		} else if(!uploadRanges.empty() || uploadPending) {
+			uploadChanges(frame);
 		}
 	}
 	void render(const FrameResource& frame) {
@@ -85,22 +347,34 @@ public:
 		context->VSSetShader(vertexShader, nullptr, 0);
 		context->PSSetShader(pixelShader, nullptr, 0);
 
-		uint strides = sizeof(Vertex);
+		uint strides = instanced ? sizeof(Info) : sizeof(Vertex);
 		uint offsets = 0;
-		context->IASetVertexBuffers(0, 1, vertexBuffer.handle.GetAddressOf(), &strides, &offsets);
+		auto buffer  = instanced ? instanceBuffer.handle.GetAddressOf() : vertexBuffer.handle.GetAddressOf();
+		context->IASetVertexBuffers(0, 1, buffer, &strides, &offsets);
+		if(animated) {
+			uint animStrides = sizeof(AnimationVertex);
+			context->IASetVertexBuffers(1, 1, animationBuffer.handle.GetAddressOf(), &animStrides, &offsets);
+		}
 
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		context->VSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
 
-		if(_texture && _sampler) {
+		bool textured = _sampler && !textures.empty();
+		if(textured) {
 			context->PSSetSamplers(0, 1, _sampler.GetAddressOf());
-			context->PSSetShaderResources(0, 1, _texture.GetAddressOf());
 		}
 
-		context->Draw((uint)quads.size()*6, 0);
+		for(auto& b : batches) {
+			if(textured) context->PSSetShaderResources(0, 1, textures[b.texture].GetAddressOf());
+			if(instanced) {
+				context->DrawInstanced(6, b.count, 0, b.start);
+			} else {
+				context->Draw(b.count*6, b.start*6);
+			}
+		}
 
 		// Clean up srv
-		if(_texture && _sampler) {
+		if(textured) {
 			ID3D11ShaderResourceView* nullsrvs[] = {nullptr};
 			context->PSSetShaderResources(0, 1, nullsrvs);
 		}
@@ -110,48 +384,349 @@ private:
 		constantBuffer.write(frame.context);
 		constantsChanged = false;
 	}
+	uint find(QuadHandle handle) const {
+		if(handle.id >= handles.size()) return NONE;
+		auto& h = handles[handle.id];
+		return h.generation == handle.generation ? h.slot : NONE;
+	}
+	QuadHandle allocateHandle(uint slot) {
+		uint id;
+		if(freeHandles.empty()) {
+			id = (uint)handles.size();
+			handles.push_back({slot, 0});
+		} else {
+			id = freeHandles.back();
+			freeHandles.pop_back();
+			handles[id].slot = slot;
+		}
+		slotHandles[slot] = id;
+		return {id, handles[id].generation};
+	}
+	template<class F> Quad& modify(QuadHandle handle, F f) {
+		uint slot = find(handle);
+		assert(slot != NONE);
+		if(slot != NONE) {
+			f(quads[slot]);
+			if(indexed) addToGrid(slot);
+			changed(slot);
+		}
+		return *this;
+	}
+	///	Queue the slot's buffer position for upload. A full rebuild writes everything anyway.
+	///	With the spatial index a quad that is not in the buffers needs a new query, but only if
+	///	it now overlaps the cull rect. Quads that leave the rect stay in the buffers until then
+	void changed(uint slot) {
+		if(pipelineChanged || visibleChanged) return;
+		uint position = slot < positions.size() ? positions[slot] : NONE;
+		if(position != NONE) {
+			uploadRanges.push_back({position, 1});
+		} else if(indexed && slotHandles[slot] != NONE && (!culling || grid.overlaps(slot, cullRect))) {
+			visibleChanged = true;
+		}
+	}
+	/// Move the live quads down over the free slots, keeping their order
+	void compact() {
+		uint n = 0;
+		for(uint slot = 0; slot < quads.size(); slot++) {
+			uint id = slotHandles[slot];
+			if(id == NONE) continue;
+			if(n != slot) {
+				quads[n] = quads[slot];
+				quadTextures[n] = quadTextures[slot];
+				if(animated) animations[n] = animations[slot];
+				slotHandles[n] = id;
+				handles[id].slot = n;
+			}
+			n++;
+		}
+		quads.resize(n);
+		quadTextures.resize(n);
+		if(animated) animations.resize(n);
+		slotHandles.resize(n);
+		freeSlots.clear();
+		numFree = 0;
+		pipelineChanged = true;
+		if(indexed) {
+			grid.clear();
+			for(uint slot = 0; slot < n; slot++) addToGrid(slot);
+		}
+	}
+	/// Bounds of the quad, including any rotation
+	void addToGrid(uint slot) {
+		auto& q = quads[slot];
+		float2 centre = q.pos + q.size * 0.5f;
+		float2 half = q.size * 0.5f;
+		if(q.rotation != 0) {
+			float r = std::sqrt(half.x*half.x + half.y*half.y);
+			half = float2(r, r);
+		}
+		grid.set(slot, centre.x - half.x, centre.y - half.y, centre.x + half.x, centre.y + half.y);
+	}
+	///	Counting sort of _slots_ by texture into order. Stable, so quads with the same texture
+	///	keep the order they were added in. Writes one Batch per texture that is used
+	void sortByTexture(const vector<uint>& slots) {
+		uint count = (uint)slots.size();
+		uint numTextures = std::max(1u, (uint)textures.size());
+		order.resize(count);
+
+		if(numTextures == 1) {
+			batches.push_back({0, 0, count});
+			std::copy(slots.begin(), slots.end(), order.begin());
+		} else {
+			vector<uint> starts(numTextures + 1, 0);
+			for(auto s : slots) starts[quadTextures[s] + 1]++;
+			for(uint t = 0; t < numTextures; t++) {
+				if(starts[t + 1] > 0) batches.push_back({t, starts[t], starts[t + 1]});
+				starts[t + 1] += starts[t];
+			}
+			for(auto s : slots) {
+				order[starts[quadTextures[s]]++] = s;
+			}
+		}
+		positions.resize(quads.size(), NONE);
+		for(uint p = 0; p < count; p++) positions[order[p]] = p;
+		sorted = indexed || batches.size() > 1;
+	}
+	///	Full rebuild: compact, sort by texture and upload everything. With the spatial index
+	///	only the live quads overlapping the cull rect are uploaded
 	void updatePipeline(const FrameResource& frame) {
-		/// 0 --- 1
-		/// | \   |
-		/// |   \ |
-		/// 3 --- 2
-		vector<Vertex> vertices;
-		vertices.reserve(6*quads.size());
-		for(auto& it : quads) {
-			vertices.push_back({it.pos, it.color, {0.0f, 0.0f}});	// 0
-			vertices.push_back({it.pos+float2(it.size.x, 0), it.color, {1.0f, 0.0f}});	// 1
-			vertices.push_back({it.pos+it.size, it.color, {1.0f, 1.0f}});	// 2
-
-			vertices.push_back({it.pos, it.color, {0.0f, 0.0f}});	// 0
-			vertices.push_back({it.pos+it.size, it.color, {1.0f, 1.0f}});	// 2
-			vertices.push_back({it.pos+float2(0, it.size.y), it.color, {0.0f, 1.0f}});	// 3
-		}
-		vertexBuffer.write(frame.context, vertices.data(), 0, (uint)vertices.size());
+		uint count = rebuild();
 		pipelineChanged = false;
+		visibleChanged = false;
+		uploadPending = false;
+		if(count > 0) upload(frame, 0, count);
+	}
+	/// Everything but the upload. Returns the number of quads to upload
+	uint rebuild() {
+		/// Quads left out by the spatial index have no buffer position
+		for(auto slot : order) positions[slot] = NONE;
+		if(pipelineChanged && numFree > 0) compact();
+		uploadRanges.clear();
+		batches.clear();
+		order.clear();
+		stats = {};
+
+		visibleSlots.clear();
+		if(indexed && culling) {
+			grid.query(cullRect, visibleSlots, stats);
+			std::sort(visibleSlots.begin(), visibleSlots.end());
+		} else {
+			for(uint slot = 0; slot < quads.size(); slot++) {
+				/// Without the index free slots stay in the buffers as zero sized quads to be reused
+				if(!indexed || slotHandles[slot] != NONE) visibleSlots.push_back(slot);
+			}
+		}
+		stats.quadsEmitted = (uint)visibleSlots.size();
+		if(visibleSlots.empty()) return 0;
+		uint count = (uint)visibleSlots.size();
+
+		sortByTexture(visibleSlots);
+		stats.drawCalls = (uint)batches.size();
+
+		if(instanced) {
+			if(sorted) {
+				sortedQuads.resize(count);
+				if(animated) animationVertices.resize(count);
+			}
+		} else {
+			vertices.resize(count * 6);
+			if(animated) animationVertices.resize(count * 6);
+		}
+		generate(0, count);
+		return count;
+	}
+	/// Upload the changed buffer positions, merging adjacent ones. Everything is uploaded if
+	/// prepare() was called
+	void uploadChanges(const FrameResource& frame) {
+		mergeSlotRanges(uploadRanges);
+		for(auto& r : uploadRanges) {
+			generate(r.start, r.count);
+			if(!uploadPending) upload(frame, r.start, r.count);
+		}
+		uploadRanges.clear();
+		if(uploadPending) {
+			uploadPending = false;
+			if(!order.empty()) upload(frame, 0, (uint)order.size());
+		}
+	}
+	/// Update the CPU copies of the buffers at positions [start, start + count). Big ranges are
+	/// split across the thread pool
+	void generate(uint start, uint count) {
+		if(pool && count >= QUADS_PER_TASK * 2) {
+			pool->parallelFor(count, QUADS_PER_TASK, [&](uint begin, uint end) {
+				generateRange(start + begin, end - begin);
+			});
+		} else {
+			generateRange(start, count);
+		}
+	}
+	/// Only writes buffer positions [start, start + count) so ranges can run concurrently
+	void generateRange(uint start, uint count) {
+		const uint* slots = order.data() + start;
+		if(instanced) {
+			if(!sorted) return;
+			for(uint i = 0; i < count; i++) {
+				sortedQuads[start + i] = quads[slots[i]];
+				if(animated) animationVertices[start + i] = animations[slots[i]];
+			}
+			return;
+		}
+		Vertex* out = vertices.data() + start*6;
+		uint i = 0;
+		for(; i + 4 <= count; i += 4) {
+			const Info* q[4] = {&quads[slots[i]], &quads[slots[i+1]], &quads[slots[i+2]], &quads[slots[i+3]]};
+			writeVertices(q, out + i*6);
+		}
+		if(i < count) {
+			/// Fill the last group up with copies of its last quad
+			const Info* q[4];
+			for(uint j = 0; j < 4; j++) q[j] = &quads[slots[std::min(i + j, count - 1)]];
+			Vertex tail[4*6];
+			writeVertices(q, tail);
+			std::copy_n(tail, (count - i)*6, out + i*6);
+		}
+		if(animated) {
+			for(uint i = 0; i < count; i++) {
+				std::fill_n(animationVertices.data() + (start + i)*6, 6, animations[slots[i]]);
+			}
+		}
+	}
+	void upload(const FrameResource& frame, uint start, uint count) {
+		if(instanced) {
+			const Info* data = sorted ? sortedQuads.data() : quads.data();
+			instanceBuffer.write(frame.context, data + start, start, count);
+			if(animated) {
+				const AnimationVertex* anim = sorted ? animationVertices.data() : animations.data();
+				animationBuffer.write(frame.context, anim + start, start, count);
+			}
+		} else {
+			vertexBuffer.write(frame.context, vertices.data() + start*6, start*6, count*6);
+			if(animated) animationBuffer.write(frame.context, animationVertices.data() + start*6, start*6, count*6);
+		}
+	}
+	///	Write the 6 vertices of each of 4 quads. The quads are transposed so that each SSE lane
+	///	holds one quad: pos and size are the first 16 bytes of an Info and uv, color and rotation
+	///	the second. SSE has no sin or cos so rotated quads get those per lane.
+	///
+	/// 0 --- 1
+	/// | \   |
+	/// |   \ |
+	/// 3 --- 2
+	static void writeVertices(const Info* const q[4], Vertex* v) {
+		__m128 x = _mm_loadu_ps(&q[0]->pos.x);
+		__m128 y = _mm_loadu_ps(&q[1]->pos.x);
+		__m128 w = _mm_loadu_ps(&q[2]->pos.x);
+		__m128 h = _mm_loadu_ps(&q[3]->pos.x);
+		_MM_TRANSPOSE4_PS(x, y, w, h);
+		__m128 uv01  = _mm_loadu_ps((const float*)q[0]->uv);
+		__m128 uv23  = _mm_loadu_ps((const float*)q[1]->uv);
+		__m128 color = _mm_loadu_ps((const float*)q[2]->uv);
+		__m128 rot   = _mm_loadu_ps((const float*)q[3]->uv);
+		_MM_TRANSPOSE4_PS(uv01, uv23, color, rot);
+
+		const __m128i low = _mm_set1_epi32(0xffff);
+		const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+		__m128 u  = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_castps_si128(uv01), low)), scale);
+		__m128 v1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(_mm_castps_si128(uv01), 16)), scale);
+		__m128 u2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_castps_si128(uv23), low)), scale);
+		__m128 v2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(_mm_castps_si128(uv23), 16)), scale);
+
+		__m128 x2 = _mm_add_ps(x, w), y2 = _mm_add_ps(y, h);
+		__m128 px[4] = {x, x2, x2, x};
+		__m128 py[4] = {y, y, y2, y2};
+
+		__m128 rotated = _mm_cmpneq_ps(rot, _mm_setzero_ps());
+		if(_mm_movemask_ps(rotated)) {
+			alignas(16) float angle[4], sn[4], cs[4];
+			_mm_store_ps(angle, rot);
+			for(uint j = 0; j < 4; j++) {
+				sn[j] = std::sin(angle[j]);
+				cs[j] = std::cos(angle[j]);
+			}
+			__m128 s = _mm_load_ps(sn), c = _mm_load_ps(cs);
+			__m128 half = _mm_set1_ps(0.5f);
+			__m128 hx = _mm_mul_ps(w, half), hy = _mm_mul_ps(h, half);
+			__m128 cx = _mm_add_ps(x, hx), cy = _mm_add_ps(y, hy);
+			__m128 nx = _mm_sub_ps(_mm_setzero_ps(), hx), ny = _mm_sub_ps(_mm_setzero_ps(), hy);
+			__m128 dx[4] = {nx, hx, hx, nx};
+			__m128 dy[4] = {ny, ny, hy, hy};
+			for(uint k = 0; k < 4; k++) {
+				__m128 rx = _mm_add_ps(cx, _mm_sub_ps(_mm_mul_ps(dx[k], c), _mm_mul_ps(dy[k], s)));
+				__m128 ry = _mm_add_ps(cy, _mm_add_ps(_mm_mul_ps(dx[k], s), _mm_mul_ps(dy[k], c)));
+				/// Unrotated lanes keep their exact corners
+				px[k] = _mm_or_ps(_mm_and_ps(rotated, rx), _mm_andnot_ps(rotated, px[k]));
+				py[k] = _mm_or_ps(_mm_and_ps(rotated, ry), _mm_andnot_ps(rotated, py[k]));
+			}
+		}
+
+		alignas(16) float X[4][4], Y[4][4], U[4], V[4], U2[4], V2[4];
+		alignas(16) uint C[4];
+		for(uint k = 0; k < 4; k++) {
+			_mm_store_ps(X[k], px[k]);
+			_mm_store_ps(Y[k], py[k]);
+		}
+		_mm_store_ps(U, u);
+		_mm_store_ps(V, v1);
+		_mm_store_ps(U2, u2);
+		_mm_store_ps(V2, v2);
+		_mm_store_ps((float*)C, color);
+
+		for(uint j = 0; j < 4; j++, v += 6) {
+			v[0] = {{X[0][j], Y[0][j]}, C[j], {U[j],  V[j]}};	// 0
+			v[1] = {{X[1][j], Y[1][j]}, C[j], {U2[j], V[j]}};	// 1
+			v[2] = {{X[2][j], Y[2][j]}, C[j], {U2[j], V2[j]}};	// 2
+
+			v[3] = v[0];										// 0
+			v[4] = v[2];										// 2
+			v[5] = {{X[3][j], Y[3][j]}, C[j], {U[j],  V2[j]}};	// 3
+		}
 	}
 	void setupPipeline(DX11& dx11) {
-		vertexBuffer.initDynamic(dx11.device, maxVertices);
+		uint maxVertices = instanced ? maxQuads : maxQuads*6;
+		if(instanced) {
+			instanceBuffer.initDynamic(dx11.device, maxQuads);
+		} else {
+			vertexBuffer.initDynamic(dx11.device, maxVertices);
+		}
+		if(animated) animationBuffer.initDynamic(dx11.device, maxVertices);
 		constantBuffer.init(dx11.device);
 
+		const auto F32x1 = DXGI_FORMAT::DXGI_FORMAT_R32_FLOAT;
 		const auto F32x2 = DXGI_FORMAT::DXGI_FORMAT_R32G32_FLOAT;
-		const auto F32x4 = DXGI_FORMAT::DXGI_FORMAT_R32G32B32A32_FLOAT;
+		const auto U16x4 = DXGI_FORMAT::DXGI_FORMAT_R16G16B16A16_UNORM;
+		const auto U8x4  = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
 
-		const D3D11_INPUT_ELEMENT_DESC layout[] = {
-			{"POSITION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"COLOR",    0, F32x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TEXCOORD", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
-		};
+		vector<D3D11_INPUT_ELEMENT_DESC> layout;
+		if(instanced) {
+			layout = {
+				{"POSITION",  0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+				{"DIMENSION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+				{"TEXCOORD",  0, U16x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+				{"COLOR",     0, U8x4,  0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+				{"ROTATION",  0, F32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+			};
+		} else {
+			layout = {
+				{"POSITION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+				{"COLOR",    0, U8x4,  0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+				{"TEXCOORD", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+			};
+		}
+		if(animated) AnimationVertex::addInputElements(layout, instanced);
 
         ShaderArgs args{};
+        if(instanced) args.entry(animated ? "VSMainInstancedAnimated" : "VSMainInstanced");
+        else if(animated) args.entry("VSMainAnimated");
         vertexShader = dx11.shaders.makeVS(dx11.params.shadersDirectory + L"quad.hlsl", args);
+        args.entry("PSMain");
         pixelShader  = dx11.shaders.makePS(dx11.params.shadersDirectory + L"quad.hlsl", args);
 
 		throwOnDXError(dx11.device->CreateInputLayout(
-			layout, 3,
+			layout.data(), (uint)layout.size(),
 			vertexShader.blob->GetBufferPointer(),
 			vertexShader.blob->GetBufferSize(),
 			inputLayout.GetAddressOf()));
 	}
 };
 
-} /// dx11
\ No newline at end of file
+} /// dx11
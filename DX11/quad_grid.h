@@ -0,0 +1,130 @@
+#pragma once
+///
+///	Loose uniform grid over the quads of a Quad, indexed by slot.
+///
+///	Each quad is stored in the cell containing its centre. Queries are expanded by the
+///	largest half extent seen so that quads overlapping a neighbouring cell are still found.
+///	Cells are created on demand and kept in a hash map so the world has no fixed bounds.
+///
+///	Moving a quad within its cell only updates its bounds. Moving it to another cell is a
+///	swap-remove from the old cell and an append to the new one.
+///
+namespace dx11 {
+
+struct QuadCullStats final {
+	uint cellsVisited;
+	uint quadsTested;		/// quads in cells crossing the edge of the rect
+	uint quadsEmitted;
+	uint drawCalls;
+};
+
+class QuadGrid final {
+	static constexpr uint NONE = 0xffffffff;
+	struct Cell final {
+		int x, y;
+		vector<uint> slots;
+	};
+	vector<Cell> cells;
+	unordered_map<ulong, uint> lookup;	/// cell coordinates -> index in cells
+	/// Indexed by slot
+	vector<uint> slotCell;				/// NONE if the slot is not in the grid
+	vector<uint> slotIndex;				/// index in the cell's slots
+	vector<float> minX, minY, maxX, maxY;
+	float cellSize = 256;
+	float margin = 0;					/// largest half extent of any quad added
+public:
+	void init(float cellSize) {
+		assert(cellSize > 0);
+		this->cellSize = cellSize;
+		clear();
+	}
+	void clear() {
+		cells.clear();
+		lookup.clear();
+		slotCell.clear();
+		slotIndex.clear();
+		minX.clear(); minY.clear(); maxX.clear(); maxY.clear();
+		margin = 0;
+	}
+	uint numCells() const { return (uint)cells.size(); }
+
+	/// Insert _slot_ or update its bounds
+	void set(uint slot, float x, float y, float x2, float y2) {
+		if(slot >= slotCell.size()) {
+			uint n = slot + 1;
+			slotCell.resize(n, NONE);
+			slotIndex.resize(n);
+			minX.resize(n); minY.resize(n); maxX.resize(n); maxY.resize(n);
+		}
+		minX[slot] = x; minY[slot] = y; maxX[slot] = x2; maxY[slot] = y2;
+		margin = std::max(margin, std::max(x2 - x, y2 - y) * 0.5f);
+
+		uint cell = findOrCreate(coord((x + x2) * 0.5f), coord((y + y2) * 0.5f));
+		if(cell == slotCell[slot]) return;
+		remove(slot);
+		slotCell[slot] = cell;
+		slotIndex[slot] = (uint)cells[cell].slots.size();
+		cells[cell].slots.push_back(slot);
+	}
+	void remove(uint slot) {
+		if(slot >= slotCell.size() || slotCell[slot] == NONE) return;
+		auto& slots = cells[slotCell[slot]].slots;
+		uint last = slots.back();
+		slots[slotIndex[slot]] = last;
+		slotIndex[last] = slotIndex[slot];
+		slots.pop_back();
+		slotCell[slot] = NONE;
+	}
+	bool overlaps(uint slot, Rect r) const {
+		return slot < slotCell.size() && slotCell[slot] != NONE &&
+			   minX[slot] <= r.x + r.width && maxX[slot] >= r.x && minY[slot] <= r.y + r.height && maxY[slot] >= r.y;
+	}
+	///	Append the slots of the quads overlapping _r_ to _out_. Cells completely inside _r_
+	///	are emitted without testing their quads
+	void query(Rect r, vector<uint>& out, QuadCullStats& stats) const {
+		float left = r.x, top = r.y, right = r.x + r.width, bottom = r.y + r.height;
+		int cx0 = coord(left - margin), cx1 = coord(right + margin);
+		int cy0 = coord(top - margin), cy1 = coord(bottom + margin);
+
+		auto visit = [&](const Cell& c) {
+			stats.cellsVisited++;
+			float x = c.x * cellSize, y = c.y * cellSize;
+			if(x >= left && y >= top && x + cellSize <= right && y + cellSize <= bottom) {
+				out.insert(out.end(), c.slots.begin(), c.slots.end());
+				return;
+			}
+			for(auto s : c.slots) {
+				stats.quadsTested++;
+				if(minX[s] <= right && maxX[s] >= left && minY[s] <= bottom && maxY[s] >= top) out.push_back(s);
+			}
+		};
+		/// Zoomed out far enough it is cheaper to look at every cell
+		ulong range = (ulong)(cx1 - cx0 + 1) * (ulong)(cy1 - cy0 + 1);
+		if(range > cells.size()) {
+			for(auto& c : cells) {
+				if(c.x >= cx0 && c.x <= cx1 && c.y >= cy0 && c.y <= cy1) visit(c);
+			}
+		} else {
+			for(int cy = cy0; cy <= cy1; cy++) {
+				for(int cx = cx0; cx <= cx1; cx++) {
+					auto it = lookup.find(key(cx, cy));
+					if(it != lookup.end()) visit(cells[it->second]);
+				}
+			}
+		}
+	}
+private:
+	int coord(float f) const {
+		return (int)std::floor(f / cellSize);
+	}
+	static ulong key(int x, int y) {
+		return ((ulong)(uint)x << 32) | (uint)y;
+	}
+	uint findOrCreate(int x, int y) {
+		auto [it, inserted] = lookup.try_emplace(key(x, y), (uint)cells.size());
+		if(inserted) cells.push_back({x, y, {}});
+		return it->second;
+	}
+};
+
+} /// dx11
@@ -0,0 +1,377 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+/// Large but finite so that the parabola intersections stay finite
+static constexpr float FAR_AWAY = 1e20f;
+
+struct SourceGlyph final {
+	uint id;
+	int x, y;
+	uint width, height;
+	int xoffset, yoffset, xadvance;
+};
+struct SourceFont final {
+	uint size, lineHeight, base;
+	vector<SourceGlyph> glyphs;
+	vector<FontKerning::Pair> kernings;
+	vector<ubyte> coverage;
+	uint2 sheetSize;
+};
+struct OutputGlyph final {
+	vector<ubyte> sdf;
+	uint2 size;
+	uint2 pos;	/// in the atlas
+};
+
+/// 1D squared distance transform of the sampled function f
+static void transform1D(const float* f, float* d, uint* v, float* z, uint n) {
+	uint k = 0;
+	v[0] = 0;
+	z[0] = -FAR_AWAY;
+	z[1] = FAR_AWAY;
+	for(uint q = 1; q < n; q++) {
+		float s;
+		while(true) {
+			uint r = v[k];
+			s = ((f[q] + (float)q*q) - (f[r] + (float)r*r)) / (2.0f*q - 2.0f*r);
+			if(s > z[k] || k == 0) break;
+			k--;
+		}
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = FAR_AWAY;
+	}
+	k = 0;
+	for(uint q = 0; q < n; q++) {
+		while(z[k + 1] < q) k++;
+		float dq = (float)q - v[k];
+		d[q] = dq*dq + f[v[k]];
+	}
+}
+void SDFGenerator::distanceTransform(const ubyte* feature, uint2 size, vector<float>& sqDistance) {
+	uint n = std::max(size.x, size.y);
+	vector<float> f(n), d(n), z(n + 1);
+	vector<uint> v(n);
+
+	sqDistance.resize((size_t)size.x * size.y);
+	for(size_t i = 0; i < sqDistance.size(); i++) {
+		sqDistance[i] = feature[i] ? 0 : FAR_AWAY;
+	}
+	/// Columns then rows
+	for(uint x = 0; x < size.x; x++) {
+		for(uint y = 0; y < size.y; y++) f[y] = sqDistance[y*size.x + x];
+		transform1D(f.data(), d.data(), v.data(), z.data(), size.y);
+		for(uint y = 0; y < size.y; y++) sqDistance[y*size.x + x] = d[y];
+	}
+	for(uint y = 0; y < size.y; y++) {
+		float* row = sqDistance.data() + (size_t)y*size.x;
+		std::copy(row, row + size.x, f.begin());
+		transform1D(f.data(), row, v.data(), z.data(), size.x);
+	}
+}
+vector<ubyte> SDFGenerator::glyph(const ubyte* coverage, uint pitch, uint2 size,
+								  float scale, uint spread, ubyte threshold, uint2& sdfSize)
+{
+	/// Pad the source so the field reaches _spread_ output pixels beyond the glyph
+	uint pad = (uint)std::ceil(spread / scale) + 1;
+	uint2 padded = {size.x + pad*2, size.y + pad*2};
+	size_t count = (size_t)padded.x * padded.y;
+
+	vector<ubyte> inside(count, 0), outside(count, 1);
+	for(uint y = 0; y < size.y; y++) {
+		for(uint x = 0; x < size.x; x++) {
+			bool in = coverage[y*pitch + x] >= threshold;
+			size_t i = (size_t)(y + pad)*padded.x + x + pad;
+			inside[i]  = in;
+			outside[i] = !in;
+		}
+	}
+	vector<float> toInside, toOutside;
+	distanceTransform(inside.data(), padded, toInside);
+	distanceTransform(outside.data(), padded, toOutside);
+
+	/// Signed distance in source pixels measured to the pixel edge, positive inside
+	vector<float> distance(count);
+	for(size_t i = 0; i < count; i++) {
+		distance[i] = inside[i] ? std::sqrt(toOutside[i]) - 0.5f : 0.5f - std::sqrt(toInside[i]);
+	}
+	const auto sample = [&](float sx, float sy) {
+		sx = std::min(std::max(sx, 0.0f), (float)padded.x - 1);
+		sy = std::min(std::max(sy, 0.0f), (float)padded.y - 1);
+		uint x0 = (uint)sx, y0 = (uint)sy;
+		uint x1 = std::min(x0 + 1, padded.x - 1), y1 = std::min(y0 + 1, padded.y - 1);
+		float fx = sx - x0, fy = sy - y0;
+		float a = distance[(size_t)y0*padded.x + x0] * (1 - fx) + distance[(size_t)y0*padded.x + x1] * fx;
+		float b = distance[(size_t)y1*padded.x + x0] * (1 - fx) + distance[(size_t)y1*padded.x + x1] * fx;
+		return a * (1 - fy) + b * fy;
+	};
+
+	sdfSize = {(uint)std::ceil(size.x * scale) + spread*2, (uint)std::ceil(size.y * scale) + spread*2};
+	vector<ubyte> sdf((size_t)sdfSize.x * sdfSize.y);
+	for(uint y = 0; y < sdfSize.y; y++) {
+		for(uint x = 0; x < sdfSize.x; x++) {
+			float sx = (x + 0.5f - spread) / scale + pad - 0.5f;
+			float sy = (y + 0.5f - spread) / scale + pad - 0.5f;
+			float d = sample(sx, sy) * scale;
+			float value = 0.5f + d / (2.0f * spread);
+			sdf[(size_t)y*sdfSize.x + x] = (ubyte)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+	return sdf;
+}
+
+static SourceFont readSource(const wstring& src) {
+	const auto getInt = [](const string& line, const string& key)->int {
+		auto p = line.find(" " + key + "=");
+		if(p == string::npos) return 0;
+		p += key.size() + 2;
+		auto e = p;
+		while(e < line.size() && line[e] > 32) e++;
+		return String::toInt(line.substr(p, e - p));
+	};
+	SourceFont font = {};
+
+	FileReader<4096> reader{src + L".fnt"};
+	while(!reader.eof()) {
+		string line = String::trimBoth(reader.readLine());
+		if(line.size() == 0) continue;
+
+		if(line.rfind("char ", 0) == 0) {
+			SourceGlyph g = {};
+			g.id       = getInt(line, "id");
+			g.x        = getInt(line, "x");
+			g.y        = getInt(line, "y");
+			g.width    = getInt(line, "width");
+			g.height   = getInt(line, "height");
+			g.xoffset  = getInt(line, "xoffset");
+			g.yoffset  = getInt(line, "yoffset");
+			g.xadvance = getInt(line, "xadvance");
+			font.glyphs.push_back(g);
+		} else if(line.rfind("kerning ", 0) == 0) {
+			font.kernings.push_back({(uint)getInt(line, "first"), (uint)getInt(line, "second"), getInt(line, "amount")});
+		} else if(line.rfind("info ", 0) == 0) {
+			font.size = std::abs(getInt(line, "size"));
+		} else if(line.rfind("common ", 0) == 0) {
+			font.lineHeight = getInt(line, "lineHeight");
+			font.base = getInt(line, "base");
+		}
+	}
+	if(font.size == 0) throw std::runtime_error("SDF source '" + WString::toString(src) + ".fnt' has no size");
+
+	string filename = WString::toString(src + L".png");
+	int x, y, n;
+	ubyte* data = stbi_load(filename.c_str(), &x, &y, &n, 0);
+	if(!data) throw std::runtime_error("Texture load error: '" + filename + "'");
+
+	/// Use alpha if there is one, otherwise the first channel
+	font.sheetSize = {(uint)x, (uint)y};
+	font.coverage.resize((size_t)x*y);
+	ubyte* src8 = data + ((n == 2 || n == 4) ? n - 1 : 0);
+	for(size_t i = 0; i < font.coverage.size(); i++) {
+		font.coverage[i] = *src8;
+		src8 += n;
+	}
+	free(data);
+
+	/// Clip glyph rects to the sheet
+	for(auto& g : font.glyphs) {
+		g.x = std::min(std::max(g.x, 0), x);
+		g.y = std::min(std::max(g.y, 0), y);
+		g.width  = std::min(g.width,  (uint)x - g.x);
+		g.height = std::min(g.height, (uint)y - g.y);
+	}
+	return font;
+}
+/// Shelf pack tallest first with a 1 pixel gap. Returns false if the glyphs do not fit
+static bool pack(vector<OutputGlyph>& glyphs, uint2 atlasSize) {
+	vector<uint> order(glyphs.size());
+	for(uint i = 0; i < order.size(); i++) order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint a, uint b) { return glyphs[a].size.y > glyphs[b].size.y; });
+
+	uint x = 1, y = 1, shelfHeight = 0;
+	for(uint i : order) {
+		auto& g = glyphs[i];
+		if(x + g.size.x + 1 > atlasSize.x) {
+			x = 1;
+			y += shelfHeight + 1;
+			shelfHeight = 0;
+		}
+		if(x + g.size.x + 1 > atlasSize.x || y + g.size.y + 1 > atlasSize.y) return false;
+		g.pos = {x, y};
+		x += g.size.x + 1;
+		shelfHeight = std::max(shelfHeight, g.size.y);
+	}
+	return true;
+}
+void SDFGenerator::generate(const wstring& src, const wstring& dest, const SDFParams& params, ThreadPool* pool) {
+	if(params.size == 0 || params.spread == 0) throw std::runtime_error("SDFParams size and spread must be non-zero");
+
+	auto source = readSource(src);
+	float scale = (float)params.size / source.size;
+	uint numGlyphs = (uint)source.glyphs.size();
+
+	vector<OutputGlyph> output(numGlyphs);
+	const auto run = [&](uint begin, uint end) {
+		for(uint i = begin; i < end; i++) {
+			auto& g = source.glyphs[i];
+			const ubyte* coverage = source.coverage.data() + (size_t)g.y*source.sheetSize.x + g.x;
+			output[i].sdf = glyph(coverage, source.sheetSize.x, {g.width, g.height}, scale, params.spread, params.threshold, output[i].size);
+		}
+	};
+	if(pool) {
+		pool->parallelFor(numGlyphs, 4, run);
+	} else {
+		run(0, numGlyphs);
+	}
+
+	uint2 atlasSize = params.atlasSize;
+	if(atlasSize.x == 0 || atlasSize.y == 0) {
+		atlasSize = {64, 64};
+		while(!pack(output, atlasSize)) {
+			if(atlasSize.x > atlasSize.y) atlasSize.y *= 2; else atlasSize.x *= 2;
+			if(atlasSize.x > 16384) throw std::runtime_error("SDF glyphs do not fit in a 16384x16384 atlas");
+		}
+	} else if(!pack(output, atlasSize)) {
+		throw std::runtime_error(String::format("SDF glyphs do not fit in a %ux%u atlas", atlasSize.x, atlasSize.y));
+	}
+
+	/// White RGBA with the field in alpha, which is the channel Fonts reads
+	vector<ubyte> atlas((size_t)atlasSize.x * atlasSize.y * 4, 0);
+	for(size_t i = 0; i < atlas.size(); i += 4) {
+		atlas[i] = atlas[i + 1] = atlas[i + 2] = 255;
+	}
+	for(auto& g : output) {
+		for(uint y = 0; y < g.size.y; y++) {
+			for(uint x = 0; x < g.size.x; x++) {
+				atlas[(((size_t)g.pos.y + y)*atlasSize.x + g.pos.x + x)*4 + 3] = g.sdf[(size_t)y*g.size.x + x];
+			}
+		}
+	}
+	writePNG(dest + L".png", atlas.data(), atlasSize);
+
+	/// .fnt in the BMFont text format
+	const auto scaled = [scale](int v) { return (int)std::lround(v * scale); };
+	wstring pageName = dest.substr(dest.find_last_of(L"/\\") + 1) + L".png";
+	int spread = (int)params.spread;
+
+	string fnt;
+	fnt += String::format("info face=\"%s\" size=%u bold=0 italic=0 charset=\"\" unicode=1 stretchH=100 smooth=1 aa=1 padding=%d,%d,%d,%d spacing=0,0\n",
+						  WString::toString(pageName.substr(0, pageName.size() - 4)).c_str(), params.size, spread, spread, spread, spread);
+	fnt += String::format("common lineHeight=%d base=%d scaleW=%u scaleH=%u pages=1 packed=0\n",
+						  scaled(source.lineHeight), scaled(source.base), atlasSize.x, atlasSize.y);
+	fnt += String::format("page id=0 file=\"%s\"\n", WString::toString(pageName).c_str());
+	fnt += String::format("chars count=%u\n", numGlyphs);
+	for(uint i = 0; i < numGlyphs; i++) {
+		auto& s = source.glyphs[i];
+		auto& g = output[i];
+		fnt += String::format("char id=%u x=%u y=%u width=%u height=%u xoffset=%d yoffset=%d xadvance=%d page=0 chnl=15\n",
+							  s.id, g.pos.x, g.pos.y, g.size.x, g.size.y,
+							  scaled(s.xoffset) - spread, scaled(s.yoffset) - spread, scaled(s.xadvance));
+	}
+	vector<string> kernings;
+	for(auto& k : source.kernings) {
+		int amount = scaled(k.amount);
+		if(amount == 0) continue;
+		kernings.push_back(String::format("kerning first=%u second=%u amount=%d\n", k.first, k.second, amount));
+	}
+	fnt += String::format("kernings count=%u\n", (uint)kernings.size());
+	for(auto& k : kernings) fnt += k;
+
+	FILE* fp = nullptr;
+	wstring fntFilename = dest + L".fnt";
+	if(_wfopen_s(&fp, fntFilename.c_str(), L"wb") != 0 || !fp) {
+		throw std::runtime_error("Unable to write '" + WString::toString(fntFilename) + "'");
+	}
+	bool ok = fwrite(fnt.data(), 1, fnt.size(), fp) == fnt.size();
+	fclose(fp);
+	if(!ok) throw std::runtime_error("Unable to write '" + WString::toString(fntFilename) + "'");
+
+	Log::format("Generated SDF font %s (%u glyphs, %ux%u atlas)", WString::toString(dest).c_str(), numGlyphs, atlasSize.x, atlasSize.y);
+}
+
+///
+///	Minimal PNG encoder. The image data is zlib compressed using stored (uncompressed)
+///	deflate blocks which every PNG reader accepts.
+///
+static uint crc32(uint crc, const ubyte* data, size_t length) {
+	static const auto table = [] {
+		std::array<uint, 256> t = {};
+		for(uint n = 0; n < 256; n++) {
+			uint c = n;
+			for(int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		return t;
+	}();
+	crc = ~crc;
+	for(size_t i = 0; i < length; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+static void putU32(vector<ubyte>& out, uint v) {
+	out.push_back((ubyte)(v >> 24));
+	out.push_back((ubyte)(v >> 16));
+	out.push_back((ubyte)(v >> 8));
+	out.push_back((ubyte)v);
+}
+static void putChunk(vector<ubyte>& out, const char* type, const vector<ubyte>& data) {
+	putU32(out, (uint)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	putU32(out, crc32(0, out.data() + start, out.size() - start));
+}
+void SDFGenerator::writePNG(const wstring& filename, const ubyte* rgba, uint2 size) {
+	/// Scanlines with filter type 0
+	size_t rowBytes = (size_t)size.x * 4;
+	vector<ubyte> raw;
+	raw.reserve((rowBytes + 1) * size.y);
+	for(uint y = 0; y < size.y; y++) {
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + y*rowBytes, rgba + (y + 1)*rowBytes);
+	}
+
+	vector<ubyte> zlib = {0x78, 0x01};
+	uint a = 1, b = 0;
+	for(size_t pos = 0; pos < raw.size() || pos == 0; ) {
+		size_t length = std::min<size_t>(65535, raw.size() - pos);
+		bool last = pos + length == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back((ubyte)length);
+		zlib.push_back((ubyte)(length >> 8));
+		zlib.push_back((ubyte)~length);
+		zlib.push_back((ubyte)(~length >> 8));
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + length);
+		for(size_t i = pos; i < pos + length; i++) {
+			a = (a + raw[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		pos += length;
+		if(last) break;
+	}
+	putU32(zlib, (b << 16) | a);
+
+	vector<ubyte> header;
+	putU32(header, size.x);
+	putU32(header, size.y);
+	header.insert(header.end(), {8, 6, 0, 0, 0});	/// 8 bit RGBA, no interlace
+
+	vector<ubyte> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	putChunk(png, "IHDR", header);
+	putChunk(png, "IDAT", zlib);
+	putChunk(png, "IEND", {});
+
+	FILE* fp = nullptr;
+	if(_wfopen_s(&fp, filename.c_str(), L"wb") != 0 || !fp) {
+		throw std::runtime_error("Unable to write '" + WString::toString(filename) + "'");
+	}
+	bool ok = fwrite(png.data(), 1, png.size(), fp) == png.size();
+	fclose(fp);
+	if(!ok) throw std::runtime_error("Unable to write '" + WString::toString(filename) + "'");
+}
+
+} /// dx11
@@ -0,0 +1,43 @@
+#pragma once
+///
+///	Builds signed distance field fonts for Text.
+///
+///	The source is a BMFont style .fnt and .png pair rendered at a high resolution as plain
+///	coverage (not a distance field). Each glyph is thresholded and an exact Euclidean
+///	distance transform (Felzenszwalb & Huttenlocher, linear time) is run on it at the source
+///	resolution. The field is then resampled to the output size, the glyphs are packed into a
+///	new atlas and a .fnt and .png are written that Fonts::get can load.
+///
+///	Distances are stored as 0.5 + d / (2 * spread) where d is positive inside the glyph,
+///	so the edge is at 0.5 as text.hlsl expects.
+///
+namespace dx11 {
+
+struct SDFParams final {
+	uint size = 32;				/// output font size in pixels
+	uint spread = 4;			/// distance range and glyph padding in output pixels
+	uint2 atlasSize = {0, 0};	/// 0 = the smallest power of 2 that fits
+	ubyte threshold = 128;		/// source coverage at or above this is inside
+};
+
+class SDFGenerator final {
+public:
+	/// Read _src_.fnt and _src_.png and write _dest_.fnt and _dest_.png. The glyphs are
+	/// processed across _pool_ if it is not null. Throws std::runtime_error on failure
+	static void generate(const wstring& src, const wstring& dest, const SDFParams& params, ThreadPool* pool = nullptr);
+
+	///
+	///	Convert one glyph's coverage bitmap into a distance field scaled by _scale_ and padded
+	///	by _spread_ pixels on every side. Returns the field, _sdfSize_ is set to its size
+	///
+	static vector<ubyte> glyph(const ubyte* coverage, uint pitch, uint2 size,
+							   float scale, uint spread, ubyte threshold, uint2& sdfSize);
+
+	/// Squared distance from every pixel to the nearest pixel where _feature_ is non-zero
+	static void distanceTransform(const ubyte* feature, uint2 size, vector<float>& sqDistance);
+
+	/// Write an 8 bit RGBA image
+	static void writePNG(const wstring& filename, const ubyte* rgba, uint2 size);
+};
+
+} /// dx11
@@ -0,0 +1,86 @@
+#pragma once
+///
+///	Rectangle packer that tracks the top edge (skyline) of the packed area.
+///	Each rectangle is placed at the position that keeps its top edge lowest,
+///	ties go to the narrowest skyline segment.
+///
+namespace dx11 {
+
+class SkylinePacker final {
+	struct Segment final {
+		uint x, y, width;
+	};
+	static constexpr uint NONE = 0xffffffff;
+
+	vector<Segment> skyline;
+	uint2 size = {0, 0};
+public:
+	void init(uint2 size) {
+		this->size = size;
+		clear();
+	}
+	void clear() {
+		skyline.assign(1, {0, 0, size.x});
+	}
+	/// Returns false if there is no room
+	bool insert(uint2 rect, uint2& pos) {
+		uint bestIndex = NONE, bestTop = NONE, bestWidth = NONE;
+		for(uint i = 0; i < skyline.size(); i++) {
+			uint y = fit(i, rect);
+			if(y == NONE) continue;
+			uint top = y + rect.y;
+			if(top < bestTop || (top == bestTop && skyline[i].width < bestWidth)) {
+				bestIndex = i;
+				bestTop   = top;
+				bestWidth = skyline[i].width;
+				pos = {skyline[i].x, y};
+			}
+		}
+		if(bestIndex == NONE) return false;
+
+		skyline.insert(skyline.begin() + bestIndex, {pos.x, pos.y + rect.y, rect.x});
+
+		/// Trim the segments now underneath the new one
+		for(uint i = bestIndex + 1; i < skyline.size(); ) {
+			auto& prev = skyline[i - 1];
+			auto& s = skyline[i];
+			uint prevEnd = prev.x + prev.width;
+			if(s.x >= prevEnd) break;
+			uint shrink = prevEnd - s.x;
+			if(s.width <= shrink) {
+				skyline.erase(skyline.begin() + i);
+			} else {
+				s.x += shrink;
+				s.width -= shrink;
+				break;
+			}
+		}
+		/// Merge neighbours at the same height
+		for(uint i = 0; i + 1 < skyline.size(); ) {
+			if(skyline[i].y == skyline[i + 1].y) {
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			} else {
+				i++;
+			}
+		}
+		return true;
+	}
+private:
+	/// Returns the y position for _rect_ if its left edge is at segment _index_, or NONE
+	uint fit(uint index, uint2 rect) const {
+		uint x = skyline[index].x;
+		if(x + rect.x > size.x) return NONE;
+		uint y = 0;
+		int widthLeft = (int)rect.x;
+		for(uint i = index; widthLeft > 0; i++) {
+			if(i == skyline.size()) return NONE;
+			y = std::max(y, skyline[i].y);
+			if(y + rect.y > size.y) return NONE;
+			widthLeft -= (int)skyline[i].width;
+		}
+		return y;
+	}
+};
+
+} /// dx11
@@ -0,0 +1,38 @@
+#pragma once
+///
+///	Ranges of slots in the CPU copy of a GPU buffer.
+///
+///	Text, TextBatch, Quad and GpuText record the slots they change and upload or draw
+///	only those ranges. Nearby ranges are merged to save calls.
+///
+namespace dx11 {
+
+struct SlotRange final {
+	uint start, count;
+};
+
+/// Visible ranges this many slots apart or closer are drawn with one call
+constexpr uint MERGE_GAP = 256;
+
+/// Sort _ranges_ by start and merge the ranges that overlap or touch
+inline void mergeSlotRanges(vector<SlotRange>& ranges) {
+	if(ranges.size() < 2) return;
+	std::sort(ranges.begin(), ranges.end(), [](const SlotRange& a, const SlotRange& b) { return a.start < b.start; });
+	uint n = 0;
+	for(uint i = 1; i < ranges.size(); i++) {
+		auto& last = ranges[n];
+		if(ranges[i].start <= last.start + last.count) {
+			last.count = std::max(last.start + last.count, ranges[i].start + ranges[i].count) - last.start;
+		} else {
+			ranges[++n] = ranges[i];
+		}
+	}
+	ranges.resize(n + 1);
+}
+
+/// Clamp _f_ to [0, 1] for a UNORM16 vertex attribute
+inline ushort toUnorm16(float f) {
+	return (ushort)(std::min(std::max(f, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+} /// dx11
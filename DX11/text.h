@@ -2,88 +2,303 @@
 ///
 ///	Display SDF text.
 ///
-///	Note: Supporting unicode
-///		wstring c = String::toWString(u8"");
-///     for(auto it : c) { 
-///			// this provides the code point value which can then be used on a sdf (extended fnt file)
-///		}
+///	Text is UTF-8. Each codepoint is looked up in the font, missing glyphs use the
+///	font's fallback glyph.
+///
+///	Multi-line text can be laid out with TextLayout and added with appendLayout().
+///
+///	If a cull rect is set only the chunks whose bounds overlap it are generated, uploaded
+///	and drawn. Chunk bounds come from Font::getRect() (cached) and are tested four at a
+///	time with SSE. Changed chunks that are off screen are generated when they come into view.
+///
+///	With enableAnimation() each glyph also gets an AnimationVertex which the vertex shader
+///	evaluates against the frame time. Glyphs reveal in order when the animation has a
+///	revealInterval (typewriter). Culling uses the positions before any movement.
+///
+///	Instanced Text can be added to a TextBatch which then uploads and draws it together with
+///	other Text objects.
+///
+///	Chunks can be clipped to a rectangle. Glyphs outside it are dropped and glyphs crossing its
+///	edge are trimmed on the CPU (position and uv) so clipped chunks need no scissor state and
+///	chunks with different clip rects are still drawn together.
+///
+///	With the DEFAULT usage chunks that have not changed for setStaticAfterFrames() frames are
+///	moved into an immutable buffer and drawn from there. A chunk that changes again goes back
+///	to the dynamic buffer. Text that is built once can use STATIC usage and text that changes
+///	every frame STREAMING usage instead.
 ///
 namespace dx11 {
 
+class TextBatch;
+
+/// How Text keeps its glyphs on the GPU
+enum class TextUsage {
+	DEFAULT,	/// changed slot ranges are updated in place. Cold chunks move to a static buffer
+	STATIC,		/// one immutable buffer, rebuilt if anything changes. All chunks are generated even when culled
+	STREAMING	/// the used slots are rewritten with map-discard whenever anything changes
+};
+
+struct TextCullStats final {
+	uint chunks;
+	uint visibleChunks;
+	uint generatedChunks;	/// regenerated by the last update
+	uint deferredChunks;	/// changed but off screen
+	uint drawCalls;
+	uint drawnSlots;		/// glyph slots drawn, including slack and off screen chunks between visible ones
+	uint staticChunks;		/// chunks in the static buffer
+};
+
 class Text {
-	struct Vertex final {
+	friend class TextBatch;
+public:
+	/// One per glyph in instanced mode. The vertex shader expands the quad from SV_VertexID.
+	/// GpuText's layout pass writes the same instances
+	struct GlyphInstance final {
 		float2 pos;
-		float2 uv;	
-		rgba color;
+		float2 dimension;
+		ushort uv[4];	/// u, v, u2, v2 (unorm16)
+		uint colour;	/// rgba8
 		float size;
-	}; static_assert(9 * 4 == sizeof(Vertex));
+	}; static_assert(8 * 4 == sizeof(GlyphInstance));
+	/// Must match the cbuffer in text.hlsl. Shared by TextBatch and GpuText
 	struct Constants final {
 		matrix viewProj;
 		rgba dropShadowColour   = rgba{0, 0, 0, 0.75f};
-		float2 dropShadowOffset = float2{-0.0025f, 0.0025f};
-		float2 _pad;
-	}; static_assert(24 * 4 == sizeof(Constants) && sizeof(Constants)%16==0);
-	struct TextChunk final {
-		string text;
-		rgba colour;
+		rgba outlineColour      = rgba{0, 0, 0, 0};
+		float2 dropShadowOffset = float2{-0.0025f, 0.0025f};	/// in atlas uv
+		float outlineWidth      = 0;	/// in distance field units (0 to 0.5)
+		float outlineSoftness   = 0;
+		float dropShadowEnabled = 0;	/// single pass only
+		float time              = 0;	/// seconds, animated only
+		float _pad[2];
+	}; static_assert(32 * 4 == sizeof(Constants) && sizeof(Constants)%16==0);
+	/// Linear clamp sampler and alpha blending. Shared by TextBatch and GpuText
+	static void createStates(ComPtr<ID3D11Device> device, ComPtr<ID3D11SamplerState>& sampler, ComPtr<ID3D11BlendState>& blendState) {
+		D3D11_SAMPLER_DESC samplerDesc;
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+		samplerDesc.MipLODBias = 0.0f;
+		samplerDesc.MaxAnisotropy = 1;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		samplerDesc.MinLOD = -FLT_MAX;
+		samplerDesc.MaxLOD = FLT_MAX;
+
+		throwOnDXError(device->CreateSamplerState(&samplerDesc, sampler.GetAddressOf()));
+
+		D3D11_BLEND_DESC blendStateDesc = {};
+		blendStateDesc.AlphaToCoverageEnable = FALSE;
+		blendStateDesc.IndependentBlendEnable = FALSE;
+		blendStateDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendStateDesc.RenderTarget[0].SrcBlend = D3D11_BLEND::D3D11_BLEND_SRC_ALPHA;
+		blendStateDesc.RenderTarget[0].DestBlend = D3D11_BLEND::D3D11_BLEND_INV_SRC_ALPHA;
+		blendStateDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP::D3D11_BLEND_OP_ADD;
+		blendStateDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND::D3D11_BLEND_ONE;
+		blendStateDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND::D3D11_BLEND_ZERO;
+		blendStateDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP::D3D11_BLEND_OP_ADD;
+		blendStateDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE::D3D11_COLOR_WRITE_ENABLE_ALL;
+
+		throwOnDXError(device->CreateBlendState(&blendStateDesc, blendState.GetAddressOf()));
+	}
+private:
+	/// The colour and glyph rect are packed like GlyphInstance so that the rect needed by
+	/// single pass shadows and outlines costs no more bandwidth than plain text
+	struct Vertex final {
+		float2 pos;
+		float2 uv;	
+		uint color;			/// rgba8
 		float size;
-		int x, y;
-	};
+		ushort uvRect[4];	/// u, v, u2, v2 of the glyph (unorm16)
+	}; static_assert(8 * 4 == sizeof(Vertex));
+	static constexpr uint UNALLOCATED = TextChunks::NONE;
+	/// Repacks of at least twice this many slots are split across the thread pool
+	static constexpr uint GLYPHS_PER_TASK = 16 * 1024;
 	
 	ComPtr<ID3D11InputLayout> inputLayout;
 	ComPtr<ID3D11SamplerState> sampler;
 	ComPtr<ID3D11BlendState> blendState;
 	VertexBuffer<Vertex> vertexBuffer;
+	VertexBuffer<GlyphInstance> instanceBuffer;
+	VertexBuffer<AnimationVertex> animationBuffer;
+	VertexBuffer<Vertex> staticVertexBuffer;
+	VertexBuffer<GlyphInstance> staticInstanceBuffer;
 	ConstantBuffer<Constants> constantBuffer;
 	VertexShader vertexShader = {};
-	PixelShader pixelShader = {}, dsPixelShader = {};
+	PixelShader pixelShader = {}, dsPixelShader = {}, combinedPixelShader = {};
 
 	float size;
 	rgba colour = rgba{1, 1, 1, 1};
-	vector<TextChunk> textChunks;
+	TextChunks chunks;
+	vector<Vertex> vertices;		/// CPU copy of the vertex buffer. 6 vertices per glyph slot
+	vector<GlyphInstance> instances;/// CPU copy of the instance buffer. 1 instance per glyph slot
+	vector<AnimationVertex> animationVertices;	/// 1 per glyph slot (instanced) or 6 per glyph slot
+	Animation animation = {};		/// applied to chunks as they are added
+	float time = 0;					/// frame time of the last update in seconds
+	Rect clipRect = {};				/// applied to chunks as they are added if clipping is set
+	vector<SlotRange> uploadRanges;
+	vector<SlotRange> drawRanges;
+	vector<SlotRange> batchUploads;	/// read and cleared by the TextBatch
+	SlotRange dirtySlots = {};		/// batched: from the first dirty chunk to the end of the last
+	/// Chunk bounds as structure of arrays padded to a multiple of 4 for the SSE cull
+	vector<float> boundsMinX, boundsMinY, boundsMaxX, boundsMaxY;
+	vector<ubyte> chunkVisible;
+	vector<uint> slotOrder;			/// chunk indexes sorted by start slot
+	vector<Vertex> staticVertices;	/// CPU copies of the static buffers
+	vector<GlyphInstance> staticInstances;
+	vector<SlotRange> staticDrawRanges;
+	vector<uint> staticOrder;		/// static chunk indexes sorted by static start slot
+	Rect cullRect = {};
+	TextCullStats stats = {};
 	Font* font;
+	ThreadPool* pool = nullptr;
 	int maxCharacters;
 	bool dropShadow;
+	bool instanced;
+	bool singlePass = true;
+	bool culling = false;
+	bool animated = false;
+	bool clipping = false;
+	bool batched = false;			/// uploads are redirected to batchUploads
+	bool slotOrderChanged = true;
+	bool staticOrderChanged = false;
+	bool atlasFull = false;			/// a dynamic font could not fit all of the glyphs prepared this update
 	bool pipelineChanged = true;
+	bool repackRequired = true;
 	bool constantsChanged = true;
 	bool isInitialised = false, cameraSet = false;
 	int numCharacters = 0;
+	uint numSlots = 0;				/// glyph slots in use including slack and holes
+	uint fontGeneration = 0;		/// font->generation when the glyphs were last generated
+	TextUsage usage = TextUsage::DEFAULT;
+	uint staticAfterFrames = 120;
+	uint staticSlots = 0;			/// used slots in the static buffer including garbage
+	uint staticGarbage = 0;			/// slots of chunks that have left the static buffer
+	ulong frameNumber = 0;
+	ulong lastMigration = 0;		/// frame number of the last check for cold chunks
 public:
-	Text& init(DX11& dx11, Font* font, bool dropShadow, int maxCharacters) {
+	/// If _instanced_ is true each glyph is uploaded as a single 32 byte instance
+	/// instead of 6 vertices (192 bytes)
+	Text& init(DX11& dx11, Font* font, bool dropShadow, int maxCharacters, bool instanced = false) {
 		this->font = font;
 		this->dropShadow = dropShadow;
+		this->instanced = instanced;
 		this->maxCharacters = maxCharacters;
 		this->size = (float)font->size;
+		this->pool = &dx11.threads;
+		constantBuffer.data.dropShadowEnabled = (dropShadow && singlePass) ? 1.0f : 0.0f;
 
 		setupPipeline(dx11);
 		isInitialised = true;
 		return *this;
 	}
+	/// Call before init()
+	Text& setUsage(TextUsage usage) {
+		assert(!isInitialised);
+		this->usage = usage;
+		return *this;
+	}
+	/// DEFAULT usage only. Chunks that have not changed for _frames_ frames are moved to the
+	/// static buffer. 0 disables this. Animated and batched Text never migrates
+	Text& setStaticAfterFrames(uint frames) {
+		staticAfterFrames = frames;
+		return *this;
+	}
+	/// Adds a per glyph animation stream. Call before init()
+	Text& enableAnimation() {
+		assert(!isInitialised);
+		animated = true;
+		return *this;
+	}
+	/// The animation given to chunks added after this. Animation{} is no animation
+	Text& setAnimation(const Animation& a) {
+		assert(animated);
+		animation = a;
+		return *this;
+	}
+	/// Replace the animation of an existing chunk and restart it
+	Text& animate(TextHandle handle, const Animation& a) {
+		assert(animated);
+		uint index = chunks.find(handle);
+		if(index == TextChunks::NONE) return *this;
+		chunks.animation[index] = a;
+		chunks.animationStart[index] = time + a.delay;
+		chunks.flags[index] |= TextChunks::DIRTY;
+		pipelineChanged = true;
+		return *this;
+	}
 	Text& camera(Camera& cam) {
 		constantBuffer.data.viewProj = cam.VP();
 		cameraSet = true;
 		constantsChanged = true;
 		return *this;
 	}
-	Text& appendText(const string& text, int x = 0, int y = 0) {
-		TextChunk chunk;
-		chunk.text = text;
-		chunk.colour = colour;
-		chunk.size = size;
-		chunk.x = x;
-		chunk.y = y;
-		textChunks.push_back(chunk);
+	Text& appendText(const string& text, float x = 0, float y = 0) {
+		addText(text, x, y);
+		return *this;
+	}
+	/// The handle stays valid until the chunk is removed, unlike its index. _x_ and _y_ need
+	/// not be whole pixels
+	TextHandle addText(const string& text, float x = 0, float y = 0) {
+		slotOrderChanged = true;
 		pipelineChanged = true;
+		auto handle = chunks.add(text, colour, size, x, y);
+		if(clipping) {
+			chunks.clip.back() = clipRect;
+			chunks.flags.back() |= TextChunks::CLIPPED;
+		}
+		if(animated) {
+			chunks.animation.back() = animation;
+			chunks.animationStart.back() = time + animation.delay;
+		}
+		return handle;
+	}
+	///	Append one chunk per line of _layout_ which must have been laid out from _text_. The
+	///	lines keep their sub-pixel positions so the glyphs land where the layout put them
+	Text& appendLayout(const string& text, const TextLayout& layout) {
+		float oldSize = size;
+		size = layout.size;
+		for(auto& line : layout.lines) {
+			if(line.numGlyphs == 0) continue;
+			appendText(text.substr(line.byteStart, line.byteEnd - line.byteStart), line.x, line.y);
+		}
+		size = oldSize;
 		return *this;
 	}
+	/// Only the replaced chunk is regenerated and uploaded. _index_ is the order the chunk
+	/// was added in as long as no chunks have been removed
 	Text& replaceText(uint index, const string& text) {
-		assert(textChunks.size()>index);
-        textChunks[index].text = text;
-        pipelineChanged = true;
+		assert(chunks.count()>index);
+		chunks.replace(index, text);
+		pipelineChanged = true;
+		return *this;
+	}
+	Text& replaceText(TextHandle handle, const string& text) {
+		uint index = chunks.find(handle);
+		assert(index != TextChunks::NONE);
+		if(index != TextChunks::NONE) replaceText(index, text);
+		return *this;
+	}
+	/// The last chunk takes the removed chunk's index. Its glyph slots are left as a hole
+	Text& removeText(TextHandle handle) {
+		uint index = chunks.find(handle);
+		if(index == TextChunks::NONE) return *this;
+		releaseSlots(index);
+		if(chunks.staticStart[index] != UNALLOCATED) staticGarbage += chunks.staticCount[index];
+		chunks.remove(index);
+		slotOrderChanged = true;
+		staticOrderChanged = true;
+		pipelineChanged = true;
 		return *this;
 	}
+	bool contains(TextHandle handle) const { return chunks.find(handle) != TextChunks::NONE; }
+	uint numChunks() const { return chunks.count(); }
 	Text& clear() {
-		textChunks.clear();
+		chunks.clear();
+		numSlots = 0;
+		dropStatic();
+		slotOrderChanged = true;
+		repackRequired = true;
 		pipelineChanged = true;
 		return *this;
 	}
@@ -95,6 +310,34 @@ public:
 		this->size = size;
 		return *this;
 	}
+	/// Chunks added after this are clipped to _r_, which is in the same space as the text
+	/// positions. Instanced drop shadows can reach up to the shadow offset past the edge
+	Text& setClipRect(Rect r) {
+		clipRect = r;
+		clipping = true;
+		return *this;
+	}
+	Text& disableClipRect() {
+		clipping = false;
+		return *this;
+	}
+	/// Change the clip rect of an existing chunk. Only that chunk is regenerated
+	Text& clipText(TextHandle handle, Rect r) {
+		uint index = chunks.find(handle);
+		if(index == TextChunks::NONE) return *this;
+		chunks.clip[index] = r;
+		chunks.flags[index] |= TextChunks::CLIPPED | TextChunks::DIRTY | TextChunks::BOUNDS_DIRTY;
+		pipelineChanged = true;
+		return *this;
+	}
+	Text& unclipText(TextHandle handle) {
+		uint index = chunks.find(handle);
+		if(index == TextChunks::NONE || !(chunks.flags[index] & TextChunks::CLIPPED)) return *this;
+		chunks.flags[index] &= ~TextChunks::CLIPPED;
+		chunks.flags[index] |= TextChunks::DIRTY | TextChunks::BOUNDS_DIRTY;
+		pipelineChanged = true;
+		return *this;
+	}
 	Text& setDropShadowColour(rgba c) {
 		constantBuffer.data.dropShadowColour = c;
 		constantsChanged = true;
@@ -103,15 +346,73 @@ public:
 	Text& setDropShadowOffset(float2 o) {
 		constantBuffer.data.dropShadowOffset = o;
 		constantsChanged = true;
+		/// Vertex mode quads are expanded on the CPU to cover the shadow
+		if(singlePass && !instanced) {
+			repackRequired = true;
+			pipelineChanged = true;
+		}
+		return *this;
+	}
+	/// Draw the fill, drop shadow and outline in one draw call (the default). If false the
+	/// drop shadow is drawn as a separate pass and the outline is not drawn
+	Text& setSinglePass(bool enable) {
+		singlePass = enable;
+		constantBuffer.data.dropShadowEnabled = (dropShadow && singlePass) ? 1.0f : 0.0f;
+		constantsChanged = true;
+		repackRequired = true;
+		pipelineChanged = true;
+		return *this;
+	}
+	/// _width_ is in distance field units (0 to 0.5). A non-zero _softness_ gives a glow.
+	/// Single pass only
+	Text& setOutline(rgba colour, float width, float softness = 0) {
+		constantBuffer.data.outlineColour = colour;
+		constantBuffer.data.outlineWidth = width;
+		constantBuffer.data.outlineSoftness = softness;
+		constantsChanged = true;
+		return *this;
+	}
+	/// Only draw chunks that overlap _visible_, which is in the same space as the text
+	/// positions (eg. the area the 2D camera can see)
+	Text& setCullRect(Rect visible) {
+		if(!culling || memcmp(&visible, &cullRect, sizeof(Rect)) != 0) {
+			cullRect = visible;
+			culling = true;
+			pipelineChanged = true;
+		}
+		return *this;
+	}
+	Text& disableCulling() {
+		if(culling) {
+			culling = false;
+			pipelineChanged = true;
+		}
+		return *this;
+	}
+	const TextCullStats& cullStats() const { return stats; }
+	/// The pool that big repacks are split across. nullptr generates everything on the calling
+	/// thread. The default is DX11::threads
+	Text& setThreadPool(ThreadPool* pool) {
+		this->pool = pool;
 		return *this;
 	}
+
 	void update(const FrameResource& frame) {
-		assert(isInitialised && cameraSet);
+		assert(isInitialised && (cameraSet || batched));
+		if(animated) {
+			/// Animation is driven by this constant alone
+			time = AnimationVertex::time(frame);
+			constantBuffer.data.time = time;
+			constantsChanged = true;
+		}
+		frameNumber = frame.number;
 		if(constantsChanged) updateConstants(frame);
-		if(pipelineChanged) updatePipeline(frame);
+		if(canMigrate() && frameNumber >= lastMigration + staticAfterFrames) migrateToStatic(frame);
+		if(pipelineChanged || font->generation != fontGeneration) updatePipeline(frame);
 	}
 	void render(const FrameResource& frame) {
 		assert(isInitialised && cameraSet);
+		assert(!batched && "A batched Text is drawn by its TextBatch");
 		if(numCharacters == 0) return;
 
 		auto context = frame.context;
@@ -119,9 +420,12 @@ public:
 		context->IASetInputLayout(inputLayout.Get());
 		context->VSSetShader(vertexShader, nullptr, 0);
 
-		uint strides = sizeof(Vertex);
-		uint offsets = 0;
-		context->IASetVertexBuffers(0, 1, vertexBuffer.handle.GetAddressOf(), &strides, &offsets);
+		/// Slot 0 is bound by draw()
+		if(animated) {
+			uint animStrides = sizeof(AnimationVertex);
+			uint offsets = 0;
+			context->IASetVertexBuffers(1, 1, animationBuffer.handle.GetAddressOf(), &animStrides, &offsets);
+		}
 
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -131,147 +435,681 @@ public:
 		context->OMSetBlendState(blendState.Get(), nullptr, 0xffffffff);
 		context->PSSetShaderResources(0, 1, font->texture.srv.GetAddressOf());
 
-		if(dropShadow) {
-			// Draw drop shadow
+		if(singlePass && (dropShadow || constantBuffer.data.outlineWidth > 0)) {
+			// Shadow, outline and fill together
 			context->PSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
-			context->PSSetShader(dsPixelShader, nullptr, 0);
-			context->Draw(numCharacters * 6, 0);
+			context->PSSetShader(combinedPixelShader, nullptr, 0);
+			draw(context);
+		} else {
+			if(dropShadow) {
+				// Draw drop shadow
+				context->PSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
+				context->PSSetShader(dsPixelShader, nullptr, 0);
+				draw(context);
+			}
+			// Normal
+			context->PSSetShader(pixelShader, nullptr, 0);
+			draw(context);
 		}
-		// Normal
-		context->PSSetShader(pixelShader, nullptr, 0);
-		context->Draw(numCharacters * 6, 0);
 
 		// Unset our srv
 		ID3D11ShaderResourceView* nullsrvs[] = {nullptr};
 		context->PSSetShaderResources(0, 1, nullsrvs);
 	}
 private:
+	/// The dynamic buffer and then the static buffer
+	void draw(ComPtr<ID3D11DeviceContext> context) {
+		if(!drawRanges.empty()) {
+			draw(context, instanced ? instanceBuffer.handle.Get() : vertexBuffer.handle.Get(), drawRanges);
+		}
+		if(!staticDrawRanges.empty()) {
+			draw(context, instanced ? staticInstanceBuffer.handle.Get() : staticVertexBuffer.handle.Get(), staticDrawRanges);
+		}
+	}
+	void draw(ComPtr<ID3D11DeviceContext> context, ID3D11Buffer* buffer, const vector<SlotRange>& ranges) {
+		uint strides = instanced ? sizeof(GlyphInstance) : sizeof(Vertex);
+		uint offsets = 0;
+		context->IASetVertexBuffers(0, 1, &buffer, &strides, &offsets);
+		for(auto& r : ranges) {
+			if(instanced) {
+				context->DrawInstanced(6, r.count, 0, r.start);
+			} else {
+				context->Draw(r.count * 6, r.start * 6);
+			}
+		}
+	}
 	void updateConstants(const FrameResource& frame) {
 		constantBuffer.write(frame.context);
 		constantsChanged = false;
 	}
+	///
+	///	Each chunk owns a range of glyph slots in the vertex buffer. Only dirty chunks are
+	///	regenerated and only their slot ranges are uploaded. Chunks are given some slack so that
+	///	small changes in length (eg. an fps counter) can be written in place. Unused slots are
+	///	filled with degenerate triangles.
+	///
+	///	If the font has a dynamic atlas and glyphs have been evicted since the last update then
+	///	every chunk is regenerated. All of the glyphs prepared by one update are one batch so
+	///	none of them is evicted by another. Glyphs that do not fit use the fallback glyph.
+	///
+	///	With culling enabled dirty chunks that are off screen are skipped and stay dirty.
+	///
+	///	A changed chunk that was in the static buffer leaves a gap there and is given dynamic
+	///	slots again. STATIC and STREAMING usage replace the whole buffer instead of uploading
+	///	the changed ranges.
+	///
 	void updatePipeline(const FrameResource& frame) {
 		pipelineChanged = false;
 		numCharacters = countCharacters();
-		if(numCharacters == 0) return;
 
-		vector<Vertex> vertices;
-		vertices.resize(numCharacters*6);
+		stats = {};
+		font->beginPrepare();
+		if(culling) {
+			updateBounds();
+			stats.visibleChunks = cull(cullRect);
+		} else {
+			stats.visibleChunks = chunks.count();
+		}
+		stats.chunks = chunks.count();
+
+		if(font->generation != fontGeneration) {
+			fontGeneration = font->generation;
+			repackRequired = true;
+		}
+
+		if(!repackRequired) {
+			for(uint i = 0; i < chunks.count(); i++) {
+				if(!(chunks.flags[i] & TextChunks::DIRTY)) continue;
+				if(chunks.staticStart[i] != UNALLOCATED) leaveStatic(i);
+				if(chunks.length[i] > chunks.capacity[i] && !reallocate(i, chunks.length[i])) {
+					repackRequired = true;
+					break;
+				}
+				if(generateNow(i)) generateChunk(i);
+			}
+		}
+		if(repackRequired) repack();
+		font->endPrepare();
+		if(atlasFull) {
+			atlasFull = false;
+			core::Log::format("Text: the atlas of %s is too small for this text. Some glyphs use the fallback glyph", core::WString::toString(font->name).c_str());
+		}
+
+		for(auto f : chunks.flags) {
+			if(f & TextChunks::DIRTY) stats.deferredChunks++;
+		}
+		updateDrawRanges();
+
+		if(font->isDynamic()) font->updateAtlas(frame.context);
 
-		auto v = 0;
-		for(auto& c : textChunks) {
-			//auto maxY = c.size;
-			float X = (float)c.x;
-			float Y = (float)c.y;
+		if(numSlots == 0) {
+			uploadRanges.clear();
+			return;
+		}
+		if(usage != TextUsage::DEFAULT && !batched) {
+			if(!uploadRanges.empty()) uploadAll(frame);
+			uploadRanges.clear();
+			return;
+		}
 
-	/*		if(unicodeAware) {
-				import std.utf : byChar, byUTF, toUTF16;
-				int i = 0;
-				foreach(ch; c.text.toUTF16) {
-					generateVertex(i++, ch);
+		/// Merge adjacent ranges to reduce the number of uploads
+		mergeSlotRanges(uploadRanges);
+		for(auto& r : uploadRanges) upload(frame, r.start, r.count);
+		uploadRanges.clear();
+	}
+	bool isVisible(uint chunkIndex) const {
+		return !culling || chunkVisible[chunkIndex];
+	}
+	/// A STATIC buffer is rebuilt whenever anything changes so off screen chunks are not deferred
+	bool generateNow(uint chunkIndex) const {
+		return usage == TextUsage::STATIC || isVisible(chunkIndex);
+	}
+	/// Replace the contents of a STATIC or STREAMING buffer with slots [0, numSlots)
+	void uploadAll(const FrameResource& frame) {
+		if(usage == TextUsage::STREAMING) {
+			upload(frame, 0, numSlots);
+			return;
+		}
+		if(instanced) {
+			instanceBuffer.initImmutable(frame.device, numSlots, instances.data());
+		} else {
+			vertexBuffer.initImmutable(frame.device, numSlots*6, vertices.data());
+		}
+		if(animated) {
+			uint n = instanced ? 1 : 6;
+			animationBuffer.initImmutable(frame.device, numSlots*n, animationVertices.data());
+		}
+	}
+	bool canMigrate() const {
+		return usage == TextUsage::DEFAULT && staticAfterFrames > 0 && !animated && !batched;
+	}
+	bool isCold(uint i) const {
+		return !(chunks.flags[i] & TextChunks::DIRTY) &&
+			   chunks.staticStart[i] == UNALLOCATED &&
+			   chunks.capacity[i] > 0 && chunks.length[i] > 0 &&
+			   frameNumber - chunks.lastChange[i] >= staticAfterFrames;
+	}
+	///	Move the chunks that have not changed for staticAfterFrames frames into a new immutable
+	///	buffer along with the chunks that are already static. Their dynamic slots become holes.
+	///	The static buffer is also rebuilt when more than half of it is garbage
+	void migrateToStatic(const FrameResource& frame) {
+		lastMigration = frameNumber;
+		uint numCold = 0;
+		for(uint i = 0; i < chunks.count(); i++) {
+			if(isCold(i)) numCold++;
+		}
+		if(numCold == 0 && staticGarbage * 2 <= staticSlots) return;
+
+		vector<Vertex> newVertices;
+		vector<GlyphInstance> newInstances;
+		uint slots = 0;
+		for(uint i = 0; i < chunks.count(); i++) {
+			bool isStatic = chunks.staticStart[i] != UNALLOCATED;
+			if(!isStatic && !isCold(i)) continue;
+			uint from  = isStatic ? chunks.staticStart[i] : chunks.start[i];
+			uint count = isStatic ? chunks.staticCount[i] : chunks.length[i];
+			if(instanced) {
+				auto& src = isStatic ? staticInstances : instances;
+				newInstances.insert(newInstances.end(), src.begin() + from, src.begin() + from + count);
+			} else {
+				auto& src = isStatic ? staticVertices : vertices;
+				newVertices.insert(newVertices.end(), src.begin() + from*6, src.begin() + (from + count)*6);
+			}
+			if(!isStatic) {
+				releaseSlots(i);
+				chunks.start[i] = UNALLOCATED;
+				chunks.capacity[i] = 0;
+			}
+			chunks.staticStart[i] = slots;
+			chunks.staticCount[i] = count;
+			slots += count;
+		}
+		staticVertices.swap(newVertices);
+		staticInstances.swap(newInstances);
+		staticSlots = slots;
+		staticGarbage = 0;
+
+		if(slots == 0) {
+			staticVertexBuffer.release();
+			staticInstanceBuffer.release();
+		} else if(instanced) {
+			staticInstanceBuffer.initImmutable(frame.device, slots, staticInstances.data());
+		} else {
+			staticVertexBuffer.initImmutable(frame.device, slots*6, staticVertices.data());
+		}
+		slotOrderChanged = true;
+		staticOrderChanged = true;
+		pipelineChanged = true;
+	}
+	/// The chunk has changed. Its glyphs in the static buffer become garbage
+	void leaveStatic(uint index) {
+		staticGarbage += chunks.staticCount[index];
+		chunks.staticStart[index] = UNALLOCATED;
+		chunks.staticCount[index] = 0;
+		staticOrderChanged = true;
+	}
+	void dropStatic() {
+		for(auto& s : chunks.staticStart) s = UNALLOCATED;
+		staticSlots = staticGarbage = 0;
+		staticVertices.clear();
+		staticInstances.clear();
+		staticDrawRanges.clear();
+		staticOrder.clear();
+		staticVertexBuffer.release();
+		staticInstanceBuffer.release();
+	}
+	///	Measure the chunks whose text has changed. Dynamic fonts need the glyphs to be
+	///	resident before they can be measured. Bounds are padded by a quarter of the size to
+	///	cover drop shadows and outlines
+	void updateBounds() {
+		uint count = chunks.count();
+		uint padded = (count + 3) & ~3u;
+		boundsMinX.resize(padded);
+		boundsMinY.resize(padded);
+		boundsMaxX.resize(padded);
+		boundsMaxY.resize(padded);
+		chunkVisible.resize(padded);
+		/// Padding never overlaps anything
+		for(uint i = count; i < padded; i++) {
+			boundsMinX[i] = boundsMinY[i] = FLT_MAX;
+			boundsMaxX[i] = boundsMaxY[i] = -FLT_MAX;
+		}
+		for(uint i = 0; i < count; i++) {
+			if(!(chunks.flags[i] & TextChunks::BOUNDS_DIRTY)) continue;
+			chunks.flags[i] &= ~TextChunks::BOUNDS_DIRTY;
+			if(chunks.length[i] == 0) {
+				boundsMinX[i] = boundsMinY[i] = FLT_MAX;
+				boundsMaxX[i] = boundsMaxY[i] = -FLT_MAX;
+				continue;
+			}
+			string text(chunks.text(i));
+			if(font->isDynamic() && !font->prepare(text)) atlasFull = true;
+			/// getRect() returns the right and bottom edges in width and height
+			Rect r = font->getRect(text, chunks.size[i]);
+			float pad = chunks.size[i] * 0.25f;
+			boundsMinX[i] = chunks.x[i] + r.x - pad;
+			boundsMinY[i] = chunks.y[i] + r.y - pad;
+			boundsMaxX[i] = chunks.x[i] + r.width + pad;
+			boundsMaxY[i] = chunks.y[i] + r.height + pad;
+			/// An empty intersection overlaps nothing
+			if(chunks.flags[i] & TextChunks::CLIPPED) {
+				const Rect& c = chunks.clip[i];
+				boundsMinX[i] = std::max(boundsMinX[i], c.x);
+				boundsMinY[i] = std::max(boundsMinY[i], c.y);
+				boundsMaxX[i] = std::min(boundsMaxX[i], c.x + c.width);
+				boundsMaxY[i] = std::min(boundsMaxY[i], c.y + c.height);
+			}
+		}
+	}
+	/// Sets chunkVisible for every chunk. Returns the number of visible chunks
+	uint cull(Rect r) {
+		const __m128 left   = _mm_set1_ps(r.x);
+		const __m128 top    = _mm_set1_ps(r.y);
+		const __m128 right  = _mm_set1_ps(r.x + r.width);
+		const __m128 bottom = _mm_set1_ps(r.y + r.height);
+		uint visible = 0;
+		for(uint i = 0; i < chunkVisible.size(); i += 4) {
+			__m128 overlap = _mm_and_ps(
+				_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&boundsMinX[i]), right), _mm_cmpge_ps(_mm_loadu_ps(&boundsMaxX[i]), left)),
+				_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&boundsMinY[i]), bottom), _mm_cmpge_ps(_mm_loadu_ps(&boundsMaxY[i]), top)));
+			int mask = _mm_movemask_ps(overlap);
+			chunkVisible[i + 0] = (ubyte)(mask & 1);
+			chunkVisible[i + 1] = (ubyte)((mask >> 1) & 1);
+			chunkVisible[i + 2] = (ubyte)((mask >> 2) & 1);
+			chunkVisible[i + 3] = (ubyte)((mask >> 3) & 1);
+			visible += std::popcount((uint)mask);
+		}
+		return visible;
+	}
+	///	Visible chunks are drawn in slot order. Neighbouring visible chunks are drawn with one
+	///	call if they are close enough, which also draws any off screen chunks between them.
+	///	Chunks that are still dirty hold stale glyphs so they always end a range
+	void updateDrawRanges() {
+		updateStaticDrawRanges();
+		drawRanges.clear();
+		if(!culling) {
+			if(numSlots > 0) drawRanges.push_back({0, numSlots});
+		} else {
+			if(slotOrderChanged) {
+				slotOrderChanged = false;
+				slotOrder.resize(chunks.count());
+				for(uint i = 0; i < slotOrder.size(); i++) slotOrder[i] = i;
+				std::sort(slotOrder.begin(), slotOrder.end(), [&](uint a, uint b) { return chunks.start[a] < chunks.start[b]; });
+			}
+			bool open = false;
+			SlotRange range = {};
+			for(auto i : slotOrder) {
+				uint start = chunks.start[i], capacity = chunks.capacity[i];
+				if(capacity == 0) continue;
+				if(chunks.flags[i] & TextChunks::DIRTY) {
+					if(open) drawRanges.push_back(range);
+					open = false;
+				} else if(chunkVisible[i]) {
+					if(open && start <= range.start + range.count + MERGE_GAP) {
+						range.count = start + capacity - range.start;
+					} else {
+						if(open) drawRanges.push_back(range);
+						range = {start, capacity};
+						open = true;
+					}
 				}
-		} else  */
-			int i = 0;
-			for(auto& ch : c.text) {
-				auto g      = font->getChar(ch);
-				float ratio = (c.size / (float)font->size);
+			}
+			if(open) drawRanges.push_back(range);
+		}
+		if(batched) updateDirtySlots();
+		stats.drawCalls = (uint)(drawRanges.size() + staticDrawRanges.size());
+		for(auto& r : drawRanges) stats.drawnSlots += r.count;
+		for(auto& r : staticDrawRanges) stats.drawnSlots += r.count;
+		stats.staticChunks = (uint)staticOrder.size();
+	}
+	/// The TextBatch must not draw across these slots when it merges the ranges of several Texts
+	void updateDirtySlots() {
+		uint first = UNALLOCATED, end = 0;
+		for(uint i = 0; i < chunks.count(); i++) {
+			if(!(chunks.flags[i] & TextChunks::DIRTY) || chunks.capacity[i] == 0) continue;
+			first = std::min(first, chunks.start[i]);
+			end = std::max(end, chunks.start[i] + chunks.capacity[i]);
+		}
+		dirtySlots = first == UNALLOCATED ? SlotRange{} : SlotRange{first, end - first};
+	}
+	/// As above for the static buffer. Ranges also end at the gaps left by chunks that have
+	/// changed since they were migrated
+	void updateStaticDrawRanges() {
+		if(staticOrderChanged) {
+			staticOrderChanged = false;
+			staticOrder.clear();
+			for(uint i = 0; i < chunks.count(); i++) {
+				if(chunks.staticStart[i] != UNALLOCATED) staticOrder.push_back(i);
+			}
+			std::sort(staticOrder.begin(), staticOrder.end(), [&](uint a, uint b) { return chunks.staticStart[a] < chunks.staticStart[b]; });
+		}
+		staticDrawRanges.clear();
+		bool open = false;
+		SlotRange range = {};
+		uint prevEnd = 0;
+		for(auto i : staticOrder) {
+			uint start = chunks.staticStart[i], count = chunks.staticCount[i];
+			/// Garbage still holds the old glyphs so it must not be drawn
+			if(open && start != prevEnd) {
+				staticDrawRanges.push_back(range);
+				open = false;
+			}
+			prevEnd = start + count;
+			if(!isVisible(i)) continue;
+			if(open && start <= range.start + range.count + MERGE_GAP) {
+				range.count = start + count - range.start;
+			} else {
+				if(open) staticDrawRanges.push_back(range);
+				range = {start, count};
+				open = true;
+			}
+		}
+		if(open) staticDrawRanges.push_back(range);
+	}
+	void upload(const FrameResource& frame, uint start, uint count) {
+		if(batched) {
+			batchUploads.push_back({start, count});
+			return;
+		}
+		if(instanced) {
+			instanceBuffer.write(frame.context, instances.data() + start, start, count);
+		} else {
+			vertexBuffer.write(frame.context, vertices.data() + start*6, start*6, count*6);
+		}
+		if(animated) {
+			uint n = instanced ? 1 : 6;
+			animationBuffer.write(frame.context, animationVertices.data() + start*n, start*n, count*n);
+		}
+	}
+	static uint withSlack(uint count) {
+		return count + std::max(4u, count / 4);
+	}
+	/// Move chunk _c_ to a bigger slot range. Returns false if there is no room
+	bool reallocate(uint index, uint count) {
+		uint capacity = withSlack(count);
+		uint& start = chunks.start[index];
+		if(start != UNALLOCATED && start + chunks.capacity[index] == numSlots) {
+			/// Last chunk. Grow in place
+			if(start + capacity > (uint)maxCharacters) return false;
+			numSlots = start + capacity;
+		} else {
+			if(numSlots + capacity > (uint)maxCharacters) return false;
+			if(start != UNALLOCATED) {
+				/// Leave a hole
+				clearSlots(start, chunks.capacity[index]);
+				uploadRanges.push_back({start, chunks.capacity[index]});
+			}
+			start = numSlots;
+			numSlots += capacity;
+			slotOrderChanged = true;
+		}
+		chunks.capacity[index] = capacity;
+		return true;
+	}
+	///	Reassign all slot ranges contiguously and regenerate every visible chunk. The glyphs of
+	///	every chunk are prepared before any chunk is written, so big repacks can write the
+	///	chunks on the thread pool
+	void repack() {
+		repackRequired = false;
+		dropStatic();
+		uint total = 0;
+		for(auto length : chunks.length) total += withSlack(length);
+		bool slack = total <= (uint)maxCharacters;
 
-				float x = X + g.xoffset * ratio;
-				float y = Y + g.yoffset * ratio;
-				float w = g.width * ratio;
-				float h = g.height * ratio;
+		numSlots = 0;
+		for(uint i = 0; i < chunks.count(); i++) {
+			chunks.start[i] = numSlots;
+			chunks.capacity[i] = slack ? withSlack(chunks.length[i]) : chunks.length[i];
+			numSlots += chunks.capacity[i];
+		}
+		for(uint i = 0; i < chunks.count(); i++) {
+			/// Off screen chunks are left dirty until they are visible
+			chunks.flags[i] |= TextChunks::DIRTY;
+			if(!generateNow(i)) continue;
+			markGenerated(i);
+			if(chunks.capacity[i] > 0) prepareChunk(i);
+		}
+		auto write = [&](uint begin, uint end) {
+			for(uint i = begin; i < end; i++) {
+				if(generateNow(i) && chunks.capacity[i] > 0) writeGlyphs(i);
+			}
+		};
+		if(pool && numSlots >= GLYPHS_PER_TASK * 2) {
+			uint chunksPerTask = (uint)((ulong)chunks.count() * GLYPHS_PER_TASK / numSlots);
+			pool->parallelFor(chunks.count(), chunksPerTask, write);
+		} else {
+			write(0, chunks.count());
+		}
+		/// Pages evicted while preparing were not used by anything written above. Chunks that
+		/// were not written are still dirty
+		fontGeneration = font->generation;
+		slotOrderChanged = true;
+		uploadRanges.clear();
+		if(numSlots > 0) uploadRanges.push_back({0, numSlots});
+	}
+	/// Free the chunk's dynamic slots. The slots are left as a hole unless they are the last
+	void releaseSlots(uint index) {
+		uint start = chunks.start[index], capacity = chunks.capacity[index];
+		if(capacity == 0) return;
+		if(start + capacity == numSlots) {
+			numSlots = start;
+		} else {
+			clearSlots(start, capacity);
+			uploadRanges.push_back({start, capacity});
+		}
+	}
+	void clearSlots(uint start, uint count) {
+		if(instanced) {
+			const GlyphInstance degenerate = {{0, 0}, {0, 0}, {0, 0, 0, 0}, 0, 0};
+			std::fill(instances.begin() + start, instances.begin() + start + count, degenerate);
+		} else {
+			const Vertex degenerate = {{0, 0}, {0, 0}, 0, 0, {0, 0, 0, 0}};
+			std::fill(vertices.begin() + start*6, vertices.begin() + (start + count)*6, degenerate);
+		}
+	}
+	/// Trim the quad and its uvs to _r_. Returns false if nothing is left
+	static bool clipGlyph(const Rect& r, float& x, float& y, float& w, float& h, float& u, float& v, float& u2, float& v2) {
+		float left   = std::max(x, r.x);
+		float top    = std::max(y, r.y);
+		float right  = std::min(x + w, r.x + r.width);
+		float bottom = std::min(y + h, r.y + r.height);
+		if(left >= right || top >= bottom) return false;
+
+		float du = (u2 - u) / w;
+		float dv = (v2 - v) / h;
+		u2 = u + (right - x) * du;
+		u  = u + (left - x) * du;
+		v2 = v + (bottom - y) * dv;
+		v  = v + (top - y) * dv;
+		x = left;
+		y = top;
+		w = right - left;
+		h = bottom - top;
+		return true;
+	}
+	void markGenerated(uint index) {
+		chunks.flags[index] &= ~TextChunks::DIRTY;
+		chunks.lastChange[index] = frameNumber;
+		stats.generatedChunks++;
+	}
+	/// Dynamic fonts: make the chunk's glyphs resident
+	void prepareChunk(uint index) {
+		if(font->isDynamic() && !font->prepare(string(chunks.text(index)))) atlasFull = true;
+	}
+	void generateChunk(uint index) {
+		markGenerated(index);
+		uint capacity = chunks.capacity[index];
+		if(capacity == 0) return;
+
+		prepareChunk(index);
+		writeGlyphs(index);
+		uploadRanges.push_back({chunks.start[index], capacity});
+	}
+	///	Write the glyph slots of chunk _index_, which must have some. Nothing outside the
+	///	chunk's slots is changed so chunks can be written concurrently once their glyphs are
+	///	resident
+	void writeGlyphs(uint index) {
+		uint start = chunks.start[index];
+		uint capacity = chunks.capacity[index];
+		auto text = chunks.text(index);
+
+		float X = chunks.x[index];
+		float Y = chunks.y[index];
+		float size = chunks.size[index];
+		float ratio = (size / (float)font->size);
+		bool kern = font->hasKerning();
+		uint colour = chunks.colour[index].toRGBA8();
+		/// Single pass drop shadows need the quad grown to cover the offset glyph. Instanced
+		/// quads are grown in the vertex shader
+		bool pad = singlePass && dropShadow && !instanced;
+		float2 uvPad = pad ? float2{std::abs(constantBuffer.data.dropShadowOffset.x), std::abs(constantBuffer.data.dropShadowOffset.y)} : float2{0, 0};
+
+		const Animation& anim = chunks.animation[index];
+		float animStart = chunks.animationStart[index];
+		bool clipped = chunks.flags[index] & TextChunks::CLIPPED;
+		const Rect& clip = chunks.clip[index];
 
+		uint i = 0;
+		uint slot = 0;		/// clipped out glyphs use no slot
+		uint prev = 0;
+		utf8::forEach(text.data(), text.data() + text.size(), [&](uint ch) {
+			auto& g = font->getChar(ch);
+
+			if(kern && i > 0) {
+				X += font->getKerning(prev, ch) * ratio;
+			}
+
+			float x = X + g.xoffset * ratio;
+			float y = Y + g.yoffset * ratio;
+			float w = g.width * ratio;
+			float h = g.height * ratio;
+			float u = g.u, v1 = g.v, u2 = g.u2, v2 = g.v2;
+			if(pad) {
+				float px = g.u2 > g.u ? uvPad.x * w / (g.u2 - g.u) : 0;
+				float py = g.v2 > g.v ? uvPad.y * h / (g.v2 - g.v) : 0;
+				x -= px; w += px*2; u -= uvPad.x; u2 += uvPad.x;
+				y -= py; h += py*2; v1 -= uvPad.y; v2 += uvPad.y;
+			}
+			if(clipped && !clipGlyph(clip, x, y, w, h, u, v1, u2, v2)) {
+				X += g.xadvance * ratio;
+				prev = ch;
+				i++;
+				return;
+			}
+
+			if(instanced) {
+				instances[start + slot] = {{x, y}, {w, h}, {toUnorm16(u), toUnorm16(v1), toUnorm16(u2), toUnorm16(v2)}, colour, size};
+			} else {
 				/// 0 --- 1
 				/// | \   |
 				/// |   \ |
 				/// 3 --- 2
-				int j = v * 6;
-				vertices[j+0] = {{x,     y}, {g.u,  g.v}, c.colour, c.size};  // 0
-				vertices[j+1] = {{x+w,   y}, {g.u2, g.v}, c.colour, c.size};  // 1
-				vertices[j+2] = {{x+w, y+h}, {g.u2, g.v2}, c.colour, c.size}; // 2
-
-				vertices[j+3] = {{x,     y}, {g.u,  g.v}, c.colour, c.size};  // 0
-				vertices[j+4] = {{x+w, y+h}, {g.u2, g.v2}, c.colour, c.size}; // 2
-				vertices[j+5] = {{x,   y+h}, {g.u,  g.v2}, c.colour, c.size}; // 3
-
-				int kerning = 0;
-				if(i+1<c.text.size()) {
-					kerning = font->getKerning(ch, c.text[i + 1]);
-				}
+				Vertex* v = vertices.data() + (start + slot)*6;
+				v[0] = {{x, y}, {u, v1}, colour, size, {toUnorm16(g.u), toUnorm16(g.v), toUnorm16(g.u2), toUnorm16(g.v2)}};  // 0
+				v[1] = v[0]; v[1].pos = {x+w,   y}; v[1].uv = {u2, v1};	// 1
+				v[2] = v[0]; v[2].pos = {x+w, y+h}; v[2].uv = {u2, v2};	// 2
 
-				X += (g.xadvance + kerning) * ratio;
-				v++;
+				v[3] = v[0];												// 0
+				v[4] = v[2];												// 2
+				v[5] = v[0]; v[5].pos = {x,   y+h}; v[5].uv = {u,  v2};	// 3
 			}
+			if(animated) {
+				auto a = AnimationVertex::make(anim, animStart, i);
+				if(instanced) {
+					animationVertices[start + slot] = a;
+				} else {
+					std::fill_n(animationVertices.data() + (start + slot)*6, 6, a);
+				}
+			}
+
+			X += g.xadvance * ratio;
+			prev = ch;
+			i++;
+			slot++;
+		});
+		/// Degenerate triangles for the unused slots
+		if(slot < capacity) {
+			clearSlots(start + slot, capacity - slot);
 		}
-		vertexBuffer.write(frame.context, vertices.data(), 0, (uint)vertices.size());
 	}
 	int countCharacters() {
 		ulong total = 0;
-		for(auto& c : textChunks) {
-			//if(unicodeAware) {
-			//	import std.utf : count;
-
-			//	total += c.text.count;
-			//} else {
-				total += c.text.size();
-			//}
+		for(auto length : chunks.length) {
+			total += length;
 		}
 		assert(total <= maxCharacters);
 		return (int)total;
 	}
+	/// STATIC buffers are created by the first update
+	template<class T> void initBuffer(VertexBuffer<T>& buffer, ComPtr<ID3D11Device> device, uint count) {
+		if(usage == TextUsage::DEFAULT) {
+			buffer.initDynamic(device, count);
+		} else if(usage == TextUsage::STREAMING) {
+			buffer.initStreaming(device, count);
+		}
+	}
 	void setupPipeline(DX11& dx11) {
-		vertexBuffer.initDynamic(dx11.device, maxCharacters * 6);
+		if(instanced) {
+			instances.resize(maxCharacters);
+			initBuffer(instanceBuffer, dx11.device, maxCharacters);
+		} else {
+			vertices.resize(maxCharacters * 6);
+			initBuffer(vertexBuffer, dx11.device, maxCharacters * 6);
+		}
+		if(animated) {
+			uint n = instanced ? maxCharacters : maxCharacters * 6;
+			animationVertices.resize(n);
+			initBuffer(animationBuffer, dx11.device, n);
+		}
 		constantBuffer.init(dx11.device);
 
 		const auto F32x1 = DXGI_FORMAT::DXGI_FORMAT_R32_FLOAT;
 		const auto F32x2 = DXGI_FORMAT::DXGI_FORMAT_R32G32_FLOAT;
-		const auto F32x4 = DXGI_FORMAT::DXGI_FORMAT_R32G32B32A32_FLOAT;
+		const auto U16x4 = DXGI_FORMAT::DXGI_FORMAT_R16G16B16A16_UNORM;
+		const auto U8x4  = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
 
 		const D3D11_INPUT_ELEMENT_DESC layout[] = {
 			{"POSITION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
 			{"TEXCOORD", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"COLOR",    0, F32x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"SIZE",     0, F32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+			{"COLOR",    0, U8x4,  0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"SIZE",     0, F32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"UVRECT",   0, U16x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+		const D3D11_INPUT_ELEMENT_DESC instanceLayout[] = {
+			{"POSITION",  0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"DIMENSION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"TEXCOORD",  0, U16x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"COLOR",     0, U8x4,  0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"SIZE",      0, F32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1}
 		};
 
+		vector<D3D11_INPUT_ELEMENT_DESC> elements;
+		if(instanced) {
+			elements.assign(std::begin(instanceLayout), std::end(instanceLayout));
+		} else {
+			elements.assign(std::begin(layout), std::end(layout));
+		}
+		if(animated) AnimationVertex::addInputElements(elements, instanced);
+
         ShaderArgs args{};
+        if(instanced) args.entry(animated ? "VSMainInstancedAnimated" : "VSMainInstanced");
+        else if(animated) args.entry("VSMainAnimated");
         vertexShader = dx11.shaders.makeVS(dx11.params.shadersDirectory + L"text.hlsl", args);
+        args.entry("PSMain");
 		pixelShader  = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
         args.entry("PSMainDropShadow");
 		dsPixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
+        args.entry("PSMainCombined");
+		combinedPixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
 
 		throwOnDXError(dx11.device->CreateInputLayout(
-			layout, 4,
+			elements.data(),
+			(uint)elements.size(),
 			vertexShader.blob->GetBufferPointer(),
 			vertexShader.blob->GetBufferSize(),
 			inputLayout.GetAddressOf()));
 
-		D3D11_SAMPLER_DESC samplerDesc;
-		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-		samplerDesc.MipLODBias = 0.0f;
-		samplerDesc.MaxAnisotropy = 1;
-		samplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-		samplerDesc.MinLOD = -FLT_MAX;
-		samplerDesc.MaxLOD = FLT_MAX;
-
-		throwOnDXError(dx11.device->CreateSamplerState(&samplerDesc, sampler.GetAddressOf()));
-
-		D3D11_BLEND_DESC blendStateDesc = {};
-		blendStateDesc.AlphaToCoverageEnable = FALSE;
-		blendStateDesc.IndependentBlendEnable = FALSE;
-		blendStateDesc.RenderTarget[0].BlendEnable = TRUE;
-		blendStateDesc.RenderTarget[0].SrcBlend = D3D11_BLEND::D3D11_BLEND_SRC_ALPHA;
-		blendStateDesc.RenderTarget[0].DestBlend = D3D11_BLEND::D3D11_BLEND_INV_SRC_ALPHA;
-		blendStateDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP::D3D11_BLEND_OP_ADD;
-		blendStateDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND::D3D11_BLEND_ONE;
-		blendStateDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND::D3D11_BLEND_ZERO;
-		blendStateDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP::D3D11_BLEND_OP_ADD;
-		blendStateDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE::D3D11_COLOR_WRITE_ENABLE_ALL;
-
-		throwOnDXError(dx11.device->CreateBlendState(&blendStateDesc, blendState.GetAddressOf()));
+		createStates(dx11.device, sampler, blendState);
 	}
 };
 
@@ -0,0 +1,260 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+static ushort scaleUnorm16(ushort v, float scale) {
+	return (ushort)(v * scale + 0.5f);
+}
+
+TextBatch& TextBatch::init(DX11& dx11, const vector<Font*>& fonts, uint maxGlyphs, bool dropShadow) {
+	if(fonts.empty()) throw std::runtime_error("TextBatch needs at least one font");
+	this->maxGlyphs = maxGlyphs;
+	this->dropShadow = dropShadow;
+	constantBuffer.data.dropShadowEnabled = dropShadow ? 1.0f : 0.0f;
+
+	uint2 size = {0, 0};
+	for(auto font : fonts) {
+		size.x = std::max(size.x, font->width);
+		size.y = std::max(size.y, font->height);
+	}
+	for(auto font : fonts) {
+		float2 uvScale = {(float)font->width / size.x, (float)font->height / size.y};
+		/// Copied on the first update
+		slices.push_back({font, 0xffffffff, uvScale});
+	}
+	atlas.init(dx11.device, size, (uint)fonts.size(), DXGI_FORMAT::DXGI_FORMAT_R8_UNORM);
+
+	setupPipeline(dx11);
+	isInitialised = true;
+	return *this;
+}
+TextBatch& TextBatch::add(Text& text) {
+	assert(isInitialised);
+	if(!text.isInitialised || !text.instanced || text.animated) {
+		throw std::runtime_error("TextBatch needs an initialised, instanced Text without animation");
+	}
+	if(text.batched) throw std::runtime_error("Text is already in a TextBatch");
+
+	uint layer = 0;
+	while(layer < slices.size() && slices[layer].font != text.font) layer++;
+	if(layer == slices.size()) throw std::runtime_error("Text uses a font that is not in the TextBatch");
+
+	/// Reuse a free region if one is big enough
+	uint capacity = (uint)text.maxCharacters;
+	Source* s = nullptr;
+	for(auto& it : sources) {
+		if(!it.text && it.capacity >= capacity) {
+			s = &it;
+			break;
+		}
+	}
+	if(!s) {
+		if(numSlots + capacity > maxGlyphs) throw std::runtime_error("TextBatch is full");
+		sources.push_back({nullptr, numSlots, capacity, 0, 0});
+		numSlots += capacity;
+		s = &sources.back();
+	}
+	s->text = &text;
+	s->layer = layer;
+	s->numSlots = text.numSlots;
+	text.batched = true;
+	text.batchUploads.clear();
+
+	/// Chunks in the Text's static buffer are given batch slots again by a repack
+	if(text.staticSlots > 0) {
+		text.repackRequired = true;
+		text.pipelineChanged = true;
+	}
+	/// Glyphs the Text generated before it was added
+	if(text.numSlots > 0) {
+		copy(*s, 0, text.numSlots);
+		uploadRanges.push_back({s->base, text.numSlots});
+	}
+	return *this;
+}
+TextBatch& TextBatch::remove(Text& text) {
+	for(auto& s : sources) {
+		if(s.text != &text) continue;
+		clearRegion(s);
+		s.text = nullptr;
+		s.numSlots = 0;
+		text.batched = false;
+		text.batchUploads.clear();
+		/// The Text's own buffer has not seen any of the changes made while it was batched
+		text.repackRequired = true;
+		text.pipelineChanged = true;
+	}
+	return *this;
+}
+void TextBatch::update(const FrameResource& frame) {
+	assert(isInitialised && cameraSet);
+	if(constantsChanged) {
+		constantBuffer.write(frame.context);
+		constantsChanged = false;
+	}
+	/// One prepare batch for all the Texts so that a Text cannot evict the glyphs another
+	/// Text has just copied into the instances
+	for(auto& slice : slices) slice.font->beginPrepare();
+	for(auto& s : sources) {
+		if(!s.text) continue;
+		auto& text = *s.text;
+		text.update(frame);
+		for(auto& r : text.batchUploads) {
+			copy(s, r.start, r.count);
+			uploadRanges.push_back({s.base + r.start, r.count});
+		}
+		text.batchUploads.clear();
+		clearTail(s);
+	}
+	for(auto& slice : slices) slice.font->endPrepare();
+	updateAtlas(frame);
+	upload(frame);
+	updateDrawRanges();
+}
+void TextBatch::render(const FrameResource& frame) {
+	assert(isInitialised && cameraSet);
+	if(drawRanges.empty()) return;
+
+	auto context = frame.context;
+	context->IASetInputLayout(inputLayout.Get());
+	context->VSSetShader(vertexShader, nullptr, 0);
+
+	uint strides = sizeof(GlyphInstance);
+	uint offsets = 0;
+	context->IASetVertexBuffers(0, 1, instanceBuffer.handle.GetAddressOf(), &strides, &offsets);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	context->VSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
+	context->PSSetConstantBuffers(0, 1, constantBuffer.handle.GetAddressOf());
+	context->PSSetSamplers(0, 1, sampler.GetAddressOf());
+	context->PSSetShaderResources(0, 1, atlas.srv.GetAddressOf());
+	context->OMSetBlendState(blendState.Get(), nullptr, 0xffffffff);
+
+	bool combined = dropShadow || constantBuffer.data.outlineWidth > 0;
+	context->PSSetShader(combined ? combinedPixelShader : pixelShader, nullptr, 0);
+
+	for(auto& r : drawRanges) {
+		context->DrawInstanced(6, r.count, 0, r.start);
+	}
+
+	ID3D11ShaderResourceView* nullsrvs[] = {nullptr};
+	context->PSSetShaderResources(0, 1, nullsrvs);
+}
+/// Copy glyph slots [start, start+count) of the Text into its region, mapping the UVs into the array
+void TextBatch::copy(const Source& s, uint start, uint count) {
+	float2 scale = slices[s.layer].uvScale;
+	auto src = s.text->instances.data() + start;
+	auto dest = instances.data() + s.base + start;
+	for(uint i = 0; i < count; i++) {
+		auto& g = src[i];
+		dest[i] = {g.pos, g.dimension,
+				   {scaleUnorm16(g.uv[0], scale.x), scaleUnorm16(g.uv[1], scale.y),
+				    scaleUnorm16(g.uv[2], scale.x), scaleUnorm16(g.uv[3], scale.y)},
+				   g.colour, g.size, s.layer};
+	}
+}
+void TextBatch::clearRegion(const Source& s) {
+	std::fill(instances.begin() + s.base, instances.begin() + s.base + s.capacity, GlyphInstance{});
+	uploadRanges.push_back({s.base, s.capacity});
+}
+/// Slots the Text no longer uses still hold its old glyphs. Clear them so that merged draw
+/// ranges can cover them
+void TextBatch::clearTail(Source& s) {
+	uint numSlots = s.text->numSlots;
+	if(numSlots < s.numSlots) {
+		std::fill(instances.begin() + s.base + numSlots, instances.begin() + s.base + s.numSlots, GlyphInstance{});
+		uploadRanges.push_back({s.base + numSlots, s.numSlots - numSlots});
+	}
+	s.numSlots = numSlots;
+}
+/// Copy the atlases that have changed into their slices
+void TextBatch::updateAtlas(const FrameResource& frame) {
+	for(uint i = 0; i < slices.size(); i++) {
+		auto& slice = slices[i];
+		if(slice.atlasVersion == slice.font->atlasVersion) continue;
+		atlas.copyToSlice(frame.context, i, slice.font->texture, {slice.font->width, slice.font->height});
+		slice.atlasVersion = slice.font->atlasVersion;
+	}
+}
+///	The ranges of each Text are already merged as far as they can be. Ranges of neighbouring
+///	Texts are merged if they are close enough and nothing in between is dirty. Free regions
+///	and the slots past the end of each Text are degenerate
+void TextBatch::updateDrawRanges() {
+	drawRanges.clear();
+	/// Every slot since the end of the last range is valid or degenerate
+	bool clean = false;
+	for(auto& s : sources) {
+		if(!s.text) continue;
+		auto& text = *s.text;
+		auto& dirty = text.dirtySlots;
+		bool first = true;
+		for(auto& r : text.drawRanges) {
+			SlotRange range = {s.base + r.start, r.count};
+			bool canMerge = first && clean && (dirty.count == 0 || dirty.start >= r.start);
+			if(canMerge && range.start <= drawRanges.back().start + drawRanges.back().count + MERGE_GAP) {
+				auto& prev = drawRanges.back();
+				prev.count = range.start + range.count - prev.start;
+			} else {
+				drawRanges.push_back(range);
+			}
+			first = false;
+		}
+		if(text.drawRanges.empty()) {
+			clean = clean && dirty.count == 0;
+		} else {
+			auto& last = text.drawRanges.back();
+			clean = dirty.count == 0 || dirty.start + dirty.count <= last.start + last.count;
+		}
+	}
+}
+/// Merge adjacent ranges to reduce the number of uploads
+void TextBatch::upload(const FrameResource& frame) {
+	mergeSlotRanges(uploadRanges);
+	for(auto& r : uploadRanges) {
+		instanceBuffer.write(frame.context, instances.data() + r.start, r.start, r.count);
+	}
+	uploadRanges.clear();
+}
+void TextBatch::setupPipeline(DX11& dx11) {
+	auto device = dx11.device;
+	instances.assign(maxGlyphs, GlyphInstance{});
+	instanceBuffer.initDynamic(device, maxGlyphs);
+	constantBuffer.init(device);
+
+	const auto F32x1 = DXGI_FORMAT::DXGI_FORMAT_R32_FLOAT;
+	const auto F32x2 = DXGI_FORMAT::DXGI_FORMAT_R32G32_FLOAT;
+	const auto U16x4 = DXGI_FORMAT::DXGI_FORMAT_R16G16B16A16_UNORM;
+	const auto U8x4  = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
+	const auto U32x1 = DXGI_FORMAT::DXGI_FORMAT_R32_UINT;
+
+	const D3D11_INPUT_ELEMENT_DESC layout[] = {
+		{"POSITION",  0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+		{"DIMENSION", 0, F32x2, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+		{"TEXCOORD",  0, U16x4, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+		{"COLOR",     0, U8x4,  0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+		{"SIZE",      0, F32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+		{"LAYER",     0, U32x1, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+	};
+
+	ShaderArgs args{};
+	args.define("TEXT_BATCH", "1");
+	args.entry("VSMainBatch");
+	vertexShader = dx11.shaders.makeVS(dx11.params.shadersDirectory + L"text.hlsl", args);
+	args.entry("PSMain");
+	pixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
+	args.entry("PSMainCombined");
+	combinedPixelShader = dx11.shaders.makePS(dx11.params.shadersDirectory + L"text.hlsl", args);
+
+	throwOnDXError(device->CreateInputLayout(
+		layout, 6,
+		vertexShader.blob->GetBufferPointer(),
+		vertexShader.blob->GetBufferSize(),
+		inputLayout.GetAddressOf()));
+
+	Text::createStates(device, sampler, blendState);
+}
+
+} /// dx11
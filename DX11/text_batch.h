@@ -0,0 +1,111 @@
+#pragma once
+///
+///	Draws many Text objects in several fonts with a single draw call.
+///
+///	The fonts' atlases are copied into the slices of one Texture2DArray. Dynamic atlases are
+///	copied again whenever they change. Glyph UVs are rescaled to the array and each glyph
+///	carries the slice of its font.
+///
+///	Added Text objects must be instanced and not animated. They keep doing their own layout,
+///	culling and dirty tracking but their uploads are redirected to the batch, which copies
+///	the changed glyph slots into one shared instance buffer. Each Text owns a region of
+///	maxCharacters slots in that buffer. The visible ranges of all the Texts are merged and
+///	drawn with one DrawInstanced unless they are far apart or a Text in between still has
+///	chunks waiting to be generated.
+///
+///	The batch has its own drop shadow and outline settings. Those of the Texts are ignored.
+///
+namespace dx11 {
+
+class TextBatch final {
+public:
+	/// Text's GlyphInstance plus the font slice. Matches VSMainBatch in text.hlsl
+	struct GlyphInstance final {
+		float2 pos;
+		float2 dimension;
+		ushort uv[4];	/// u, v, u2, v2 in the array as unorm16
+		uint colour;	/// rgba8
+		float size;
+		uint layer;
+	}; static_assert(9 * 4 == sizeof(GlyphInstance));
+private:
+	using Constants = Text::Constants;
+	struct Source final {
+		Text* text;			/// nullptr if the region is free
+		uint base;			/// first slot of the region
+		uint capacity;
+		uint layer;
+		uint numSlots;		/// slots of the Text copied into the region. The rest are degenerate
+	};
+	struct Slice final {
+		Font* font;
+		uint atlasVersion;
+		float2 uvScale;		/// font atlas size / array size
+	};
+	vector<Slice> slices;
+	vector<Source> sources;
+	vector<GlyphInstance> instances;	/// CPU copy of the instance buffer
+	vector<SlotRange> uploadRanges;
+	vector<SlotRange> drawRanges;
+	uint maxGlyphs = 0;
+	uint numSlots = 0;					/// end of the last region
+	bool dropShadow = false;
+	bool constantsChanged = true;
+	bool isInitialised = false, cameraSet = false;
+
+	Texture2DArray atlas;
+	VertexBuffer<GlyphInstance> instanceBuffer;
+	ConstantBuffer<Constants> constantBuffer;
+	ComPtr<ID3D11InputLayout> inputLayout;
+	VertexShader vertexShader = {};
+	PixelShader pixelShader = {}, combinedPixelShader = {};
+	ComPtr<ID3D11SamplerState> sampler;
+	ComPtr<ID3D11BlendState> blendState;
+public:
+	/// Every Text added later must use one of _fonts_
+	TextBatch& init(DX11& dx11, const vector<Font*>& fonts, uint maxGlyphs, bool dropShadow = false);
+
+	TextBatch& camera(Camera& cam) {
+		constantBuffer.data.viewProj = cam.VP();
+		cameraSet = true;
+		constantsChanged = true;
+		return *this;
+	}
+	TextBatch& setDropShadowColour(rgba c) {
+		constantBuffer.data.dropShadowColour = c;
+		constantsChanged = true;
+		return *this;
+	}
+	TextBatch& setDropShadowOffset(float2 o) {
+		constantBuffer.data.dropShadowOffset = o;
+		constantsChanged = true;
+		return *this;
+	}
+	TextBatch& setOutline(rgba colour, float width, float softness = 0) {
+		constantBuffer.data.outlineColour = colour;
+		constantBuffer.data.outlineWidth = width;
+		constantBuffer.data.outlineSoftness = softness;
+		constantsChanged = true;
+		return *this;
+	}
+	/// _text_ must be initialised, instanced and use one of the batch fonts. It is updated
+	/// and drawn by the batch from now on. Throws if the batch is full
+	TextBatch& add(Text& text);
+	TextBatch& remove(Text& text);
+
+	uint numDrawCalls() const { return (uint)drawRanges.size(); }
+
+	/// Updates every added Text and uploads their changes
+	void update(const FrameResource& frame);
+	void render(const FrameResource& frame);
+private:
+	void setupPipeline(DX11& dx11);
+	void copy(const Source& s, uint start, uint count);
+	void clearRegion(const Source& s);
+	void clearTail(Source& s);
+	void updateAtlas(const FrameResource& frame);
+	void updateDrawRanges();
+	void upload(const FrameResource& frame);
+};
+
+} /// dx11
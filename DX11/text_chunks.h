@@ -0,0 +1,216 @@
+#pragma once
+///
+///	Chunk storage for Text.
+///
+///	- The text of every chunk lives in one arena. Each chunk owns a span with some slack
+///	  so that replacing it with text of a similar length is done in place. Outgrown spans
+///	  are abandoned and the arena is compacted once more than half of it is unused
+///	- Metadata is a structure of arrays indexed by chunk. Removing a chunk moves the last
+///	  chunk into its place so chunk indexes are only stable while nothing is removed
+///	- Handles stay valid until their chunk is removed. A stale handle is detected by its
+///	  generation
+///
+namespace dx11 {
+
+struct TextHandle final {
+	uint id = 0xffffffff;
+	uint generation = 0;
+};
+
+class TextChunks final {
+public:
+	static constexpr uint NONE = 0xffffffff;
+	enum Flags : ubyte { DIRTY = 1, BOUNDS_DIRTY = 2, CLIPPED = 4 };
+
+	vector<uint> length;		/// number of codepoints
+	vector<rgba> colour;
+	vector<float> size;
+	vector<float> x, y;			/// pen position at the top of the line
+	vector<uint> start;			/// first glyph slot, NONE if no slots are allocated
+	vector<uint> capacity;		/// glyph slots reserved
+	vector<ubyte> flags;
+	vector<Animation> animation;
+	vector<float> animationStart;	/// seconds
+	vector<uint> staticStart;		/// first slot in the static buffer, NONE if not static
+	vector<uint> staticCount;
+	vector<ulong> lastChange;		/// frame number when the glyphs were last generated
+	vector<Rect> clip;				/// glyphs are trimmed to this if the CLIPPED flag is set
+private:
+	struct Handle final {
+		uint chunk;				/// NONE if free
+		uint generation;
+	};
+	static constexpr uint MIN_COMPACT_BYTES = 4096;
+
+	vector<uint> textOffset, textBytes, textCapacity;
+	vector<uint> handleIds;		/// chunk -> handle id
+	vector<char> arena;
+	uint arenaUnused = 0;
+	vector<Handle> handles;
+	vector<uint> freeHandles;
+public:
+	uint count() const { return (uint)length.size(); }
+	std::string_view text(uint index) const {
+		return {arena.data() + textOffset[index], textBytes[index]};
+	}
+	uint arenaSize() const { return (uint)arena.size(); }
+	uint arenaUnusedBytes() const { return arenaUnused; }
+
+	TextHandle add(std::string_view str, rgba c, float sz, float px, float py) {
+		uint index = count();
+		length.push_back(utf8::count(str.data(), str.data() + str.size()));
+		colour.push_back(c);
+		size.push_back(sz);
+		x.push_back(px);
+		y.push_back(py);
+		start.push_back(NONE);
+		capacity.push_back(0);
+		flags.push_back(DIRTY | BOUNDS_DIRTY);
+		animation.push_back({});
+		animationStart.push_back(0);
+		staticStart.push_back(NONE);
+		staticCount.push_back(0);
+		lastChange.push_back(0);
+		clip.push_back({});
+
+		textOffset.push_back(allocateSpan(str));
+		textBytes.push_back((uint)str.size());
+		textCapacity.push_back(withSlack((uint)str.size()));
+
+		uint id;
+		if(freeHandles.empty()) {
+			id = (uint)handles.size();
+			handles.push_back({index, 0});
+		} else {
+			id = freeHandles.back();
+			freeHandles.pop_back();
+			handles[id].chunk = index;
+		}
+		handleIds.push_back(id);
+		return {id, handles[id].generation};
+	}
+	void replace(uint index, std::string_view str) {
+		uint bytes = (uint)str.size();
+		if(bytes <= textCapacity[index]) {
+			memcpy(arena.data() + textOffset[index], str.data(), bytes);
+		} else {
+			arenaUnused += textCapacity[index];
+			textOffset[index] = allocateSpan(str);
+			textCapacity[index] = withSlack(bytes);
+		}
+		textBytes[index] = bytes;
+		length[index] = utf8::count(str.data(), str.data() + str.size());
+		flags[index] |= DIRTY | BOUNDS_DIRTY;
+		compactIfSparse();
+	}
+	/// Moves the last chunk into _index_. Its bounds need to be measured again because
+	/// anything indexed by chunk (eg. cull results) now refers to the wrong chunk
+	void remove(uint index) {
+		auto& h = handles[handleIds[index]];
+		h.chunk = NONE;
+		h.generation++;
+		freeHandles.push_back(handleIds[index]);
+		arenaUnused += textCapacity[index];
+
+		uint last = count() - 1;
+		if(index != last) {
+			length[index]         = length[last];
+			colour[index]         = colour[last];
+			size[index]           = size[last];
+			x[index]              = x[last];
+			y[index]              = y[last];
+			start[index]          = start[last];
+			capacity[index]       = capacity[last];
+			flags[index]          = flags[last] | BOUNDS_DIRTY;
+			animation[index]      = animation[last];
+			animationStart[index] = animationStart[last];
+			staticStart[index]    = staticStart[last];
+			staticCount[index]    = staticCount[last];
+			lastChange[index]     = lastChange[last];
+			clip[index]           = clip[last];
+			textOffset[index]     = textOffset[last];
+			textBytes[index]      = textBytes[last];
+			textCapacity[index]   = textCapacity[last];
+			handleIds[index]      = handleIds[last];
+			handles[handleIds[index]].chunk = index;
+		}
+		length.pop_back();
+		colour.pop_back();
+		size.pop_back();
+		x.pop_back();
+		y.pop_back();
+		start.pop_back();
+		capacity.pop_back();
+		flags.pop_back();
+		animation.pop_back();
+		animationStart.pop_back();
+		staticStart.pop_back();
+		staticCount.pop_back();
+		lastChange.pop_back();
+		clip.pop_back();
+		textOffset.pop_back();
+		textBytes.pop_back();
+		textCapacity.pop_back();
+		handleIds.pop_back();
+		compactIfSparse();
+	}
+	/// Invalidates every handle
+	void clear() {
+		for(uint i = 0; i < count(); i++) {
+			auto& h = handles[handleIds[i]];
+			h.chunk = NONE;
+			h.generation++;
+			freeHandles.push_back(handleIds[i]);
+		}
+		length.clear();
+		colour.clear();
+		size.clear();
+		x.clear();
+		y.clear();
+		start.clear();
+		capacity.clear();
+		flags.clear();
+		animation.clear();
+		animationStart.clear();
+		staticStart.clear();
+		staticCount.clear();
+		lastChange.clear();
+		clip.clear();
+		textOffset.clear();
+		textBytes.clear();
+		textCapacity.clear();
+		handleIds.clear();
+		arena.clear();
+		arenaUnused = 0;
+	}
+	/// Returns the chunk index or NONE if _h_ is stale
+	uint find(TextHandle h) const {
+		if(h.id >= handles.size() || handles[h.id].generation != h.generation) return NONE;
+		return handles[h.id].chunk;
+	}
+private:
+	static uint withSlack(uint bytes) {
+		return bytes + std::max(8u, bytes / 4);
+	}
+	uint allocateSpan(std::string_view str) {
+		uint offset = (uint)arena.size();
+		arena.resize(arena.size() + withSlack((uint)str.size()));
+		memcpy(arena.data() + offset, str.data(), str.size());
+		return offset;
+	}
+	void compactIfSparse() {
+		if(arenaUnused < MIN_COMPACT_BYTES || arenaUnused * 2 < arena.size()) return;
+
+		vector<char> compacted;
+		compacted.reserve(arena.size() - arenaUnused);
+		for(uint i = 0; i < count(); i++) {
+			uint offset = (uint)compacted.size();
+			compacted.insert(compacted.end(), arena.begin() + textOffset[i], arena.begin() + textOffset[i] + textCapacity[i]);
+			textOffset[i] = offset;
+		}
+		arena.swap(compacted);
+		arenaUnused = 0;
+	}
+};
+
+} /// dx11
@@ -0,0 +1,166 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+static constexpr uint NO_BREAK = 0xffffffff;
+
+void TextLayout::layout(const Font& font, const string& text, const LayoutParams& params) {
+	glyphs.clear();
+	lines.clear();
+	size = params.size > 0 ? params.size : (float)font.size;
+	bounds = {params.x, params.y, 0, 0};
+	if(text.empty()) return;
+
+	glyphs.reserve(text.size());
+
+	const float ratio      = size / (float)font.size;
+	const float base       = font.base * ratio;
+	const float lineHeight = font.lineHeight * ratio * params.lineSpacing;
+	const float maxWidth   = params.maxWidth;
+	const bool wrap        = maxWidth > 0;
+	const bool kern        = font.hasKerning();
+	const float top        = params.baseline ? params.y - base : params.y;
+
+	/// Glyph x values are relative to the line start until the line is finished
+	LayoutLine line = {};
+	float X = 0;
+	float contentEnd = 0;		/// X at the end of the last non-space glyph
+	float lineY = top;
+	uint prev = 0;
+	bool hasPrev = false;
+	bool prevIsSpace = false;
+
+	/// The most recent place the line can be wrapped (the first glyph after a run of spaces)
+	uint breakGlyph = NO_BREAK;
+	uint breakByte = 0;
+	float breakX = 0, breakWidth = 0;
+
+	const auto finishLine = [&](uint endGlyph, uint endByte, float width) {
+		line.numGlyphs = endGlyph - line.firstGlyph;
+		line.byteEnd   = endByte;
+		line.width     = width;
+		line.x         = params.x;
+		line.y         = lineY;
+		line.baseline  = lineY + base;
+		if(wrap) {
+			if(params.align == TextAlign::CENTRE) line.x += (maxWidth - width) * 0.5f;
+			else if(params.align == TextAlign::RIGHT) line.x += maxWidth - width;
+		}
+		for(uint i = line.firstGlyph; i < endGlyph; i++) {
+			glyphs[i].x += line.x;
+		}
+		lines.push_back(line);
+		lineY += lineHeight;
+	};
+	const auto startLine = [&](uint firstGlyph, uint byteStart) {
+		line = {};
+		line.firstGlyph = firstGlyph;
+		line.byteStart  = byteStart;
+		breakGlyph = NO_BREAK;
+	};
+
+	utf8::forEachOffset(text.data(), text.data() + text.size(), [&](uint ch, uint begin, uint end) {
+		if(ch == '\r') return;
+		if(ch == '\n') {
+			finishLine((uint)glyphs.size(), begin, contentEnd);
+			startLine((uint)glyphs.size(), end);
+			X = contentEnd = 0;
+			hasPrev = prevIsSpace = false;
+			return;
+		}
+		auto& g = font.getChar(ch);
+		bool isSpace = ch == ' ';
+
+		if(kern && hasPrev) {
+			X += font.getKerning(prev, ch) * ratio;
+		}
+		float advance = g.xadvance * ratio;
+
+		if(wrap && !isSpace && X + advance > maxWidth) {
+			/// If the previous glyph was a space this glyph starts the word, otherwise go
+			/// back to the start of the current word
+			if(!prevIsSpace && breakGlyph != NO_BREAK) {
+				/// Move the partial word onto a new line
+				finishLine(breakGlyph, breakByte, breakWidth);
+				startLine(breakGlyph, breakByte);
+				for(uint i = line.firstGlyph; i < glyphs.size(); i++) {
+					glyphs[i].x -= breakX;
+					glyphs[i].y = lineY;
+				}
+				X -= breakX;
+				contentEnd -= breakX;
+			}
+			if(X + advance > maxWidth && glyphs.size() > line.firstGlyph) {
+				/// Break before this glyph
+				finishLine((uint)glyphs.size(), begin, contentEnd);
+				startLine((uint)glyphs.size(), begin);
+				X = contentEnd = 0;
+			}
+		}
+		if(prevIsSpace && !isSpace && glyphs.size() > line.firstGlyph) {
+			breakGlyph = (uint)glyphs.size();
+			breakByte  = begin;
+			breakX     = X;
+			breakWidth = contentEnd;
+		}
+
+		glyphs.push_back({ch, X, lineY});
+		X += advance;
+		if(!isSpace) contentEnd = X;
+
+		prev = ch;
+		hasPrev = true;
+		prevIsSpace = isSpace;
+	});
+	finishLine((uint)glyphs.size(), (uint)text.size(), contentEnd);
+
+	float width = 0;
+	for(auto& l : lines) width = std::max(width, l.width);
+
+	/// Without a wrap width the lines are aligned to the widest line
+	if(!wrap && params.align != TextAlign::LEFT) {
+		for(auto& l : lines) {
+			float offset = width - l.width;
+			if(params.align == TextAlign::CENTRE) offset *= 0.5f;
+			l.x += offset;
+			for(uint i = l.firstGlyph; i < l.firstGlyph + l.numGlyphs; i++) {
+				glyphs[i].x += offset;
+			}
+		}
+	}
+
+	bounds.x = params.x;
+	if(wrap) {
+		if(params.align == TextAlign::CENTRE) bounds.x += (maxWidth - width) * 0.5f;
+		else if(params.align == TextAlign::RIGHT) bounds.x += maxWidth - width;
+	}
+	bounds.y      = top;
+	bounds.width  = width;
+	bounds.height = (float)lines.size() * lineHeight;
+}
+void TextLayout::layout(const Font& font,
+						const vector<string>& texts,
+						const vector<LayoutParams>& params,
+						vector<TextLayout>& layouts,
+						ThreadPool* pool)
+{
+	assert(texts.size() == params.size());
+	uint count = (uint)texts.size();
+	layouts.resize(count);
+
+	const auto run = [&](uint begin, uint end) {
+		for(uint i = begin; i < end; i++) {
+			layouts[i].layout(font, texts[i], params[i]);
+		}
+	};
+	if(pool) {
+		pool->parallelFor(count, 64, run);
+	} else {
+		run(0, count);
+	}
+}
+
+} /// dx11
@@ -0,0 +1,62 @@
+#pragma once
+///
+///	Multi-line text layout.
+///
+///	Lays out UTF-8 text in a single pass over the codepoints:
+///		- '\n' starts a new line, '\r' is ignored
+///		- If maxWidth > 0, lines are wrapped after the last space that fits. Words that are
+///		  wider than maxWidth are broken at the glyph that overflows
+///		- Lines are Font::lineHeight * lineSpacing apart (scaled to the layout size)
+///		- Trailing spaces are kept in the line but do not count towards its width
+///
+///	Glyph and line positions are pen positions at the top of the line, the same origin that
+///	Text::appendText uses, so a laid out line can be passed straight to Text.
+///
+///	Fonts with a dynamic atlas only have metrics for glyphs that are resident so call
+///	Font::prepare() on the text first.
+///
+namespace dx11 {
+
+enum class TextAlign : uint { LEFT, CENTRE, RIGHT };
+
+struct LayoutParams final {
+	float x = 0, y = 0;
+	float size = 0;				/// 0 = the font's own size
+	float maxWidth = 0;			/// 0 = only break on newlines
+	float lineSpacing = 1;
+	TextAlign align = TextAlign::LEFT;
+	bool baseline = false;		/// true if _y_ is the baseline of the first line rather than its top
+};
+struct LayoutGlyph final {
+	uint codepoint;
+	float x, y;
+};
+struct LayoutLine final {
+	uint firstGlyph, numGlyphs;
+	uint byteStart, byteEnd;	/// range of the source text
+	float x, y;
+	float width;
+	float baseline;
+};
+///================================================================================= TextLayout
+class TextLayout final {
+public:
+	vector<LayoutGlyph> glyphs;
+	vector<LayoutLine> lines;
+	Rect bounds = {};
+	float size = 0;
+
+	/// Replaces the current contents. The vectors are reused so a TextLayout can be laid out
+	/// repeatedly without allocating
+	void layout(const Font& font, const string& text, const LayoutParams& params);
+
+	/// Lay out texts[i] with params[i] into layouts[i]. If _pool_ is not null the labels are
+	/// spread across its threads
+	static void layout(const Font& font,
+					   const vector<string>& texts,
+					   const vector<LayoutParams>& params,
+					   vector<TextLayout>& layouts,
+					   ThreadPool* pool = nullptr);
+};
+
+} /// dx11
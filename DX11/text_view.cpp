@@ -0,0 +1,128 @@
+#include "_pch.h"
+#include "_exported.h"
+
+namespace dx11 {
+
+using namespace core;
+
+TextView& TextView::init(DX11& dx11, Font* font, const TextViewParams& params) {
+	this->font = font;
+	this->params = params;
+	if(this->params.size <= 0) this->params.size = (float)font->size;
+
+	rowHeight = font->lineHeight * (this->params.size / font->size) * params.lineSpacing;
+	visibleRows = std::max(1u, (uint)(params.height / rowHeight));
+
+	text.init(dx11, font, false, (int)(visibleRows * params.maxColumns), true)
+		.setSize(this->params.size)
+		.setColour(params.colour);
+	for(uint i = 0; i < visibleRows; i++) {
+		text.appendText("", (int)std::lround(params.x), (int)std::lround(params.y + i * rowHeight));
+	}
+	clear();
+	return *this;
+}
+TextView& TextView::append(const string& str) {
+	if(str.empty()) return *this;
+	uint oldSize = (uint)document.size();
+	document += str;
+
+	/// The last row belongs to the unfinished last line. Wrap again from its start
+	uint changedRow = (uint)rows.size() - 1;
+	uint start = rows.back().byteStart;
+	rows.pop_back();
+
+	const char* base = document.data();
+	const char* end  = base + document.size();
+	for(const char* p = base + oldSize; (p = (const char*)memchr(p, '\n', end - p)) != nullptr; p++) {
+		uint newline = (uint)(p - base);
+		addRows(start, newline);
+		start = newline + 1;
+		lineStarts.push_back(start);
+	}
+	addRows(start, (uint)document.size());
+
+	if(followTail) {
+		uint first = lastFirstRow();
+		if(first != firstRow) {
+			firstRow = first;
+			windowChanged = true;
+		}
+	}
+	if(changedRow < firstRow + visibleRows) windowChanged = true;
+	return *this;
+}
+TextView& TextView::clear() {
+	document.clear();
+	lineStarts.assign(1, 0);
+	rows.assign(1, {0, 0});
+	firstRow = 0;
+	followTail = true;
+	windowChanged = true;
+	return *this;
+}
+TextView& TextView::scrollTo(uint row) {
+	row = std::min(row, lastFirstRow());
+	followTail = row == lastFirstRow();
+	if(row != firstRow) {
+		firstRow = row;
+		windowChanged = true;
+	}
+	return *this;
+}
+TextView& TextView::scrollBy(int delta) {
+	int row = std::max(0, (int)firstRow + delta);
+	return scrollTo((uint)row);
+}
+TextView& TextView::scrollToEnd() {
+	return scrollTo(lastFirstRow());
+}
+uint TextView::rowOfLine(uint line) const {
+	if(line >= lineStarts.size()) return (uint)rows.size() - 1;
+	uint byte = lineStarts[line];
+	auto it = std::lower_bound(rows.begin(), rows.end(), byte, [](const Row& r, uint b) { return r.byteStart < b; });
+	return (uint)(it - rows.begin());
+}
+void TextView::update(const FrameResource& frame) {
+	if(windowChanged) {
+		windowChanged = false;
+		for(uint i = 0; i < visibleRows; i++) {
+			uint row = firstRow + i;
+			text.replaceText(i, row < rows.size() ? rowText(row) : "");
+		}
+	}
+	text.update(frame);
+}
+/// Add the rows for the line segment [start, end) which contains no newlines
+void TextView::addRows(uint start, uint end) {
+	/// Trailing '\r' of a CRLF line ending
+	if(end > start && document[end - 1] == '\r') end--;
+
+	if(params.width <= 0 || end == start) {
+		rows.push_back({start, end});
+		return;
+	}
+	string segment = document.substr(start, end - start);
+	if(font->isDynamic()) font->prepare(segment);
+
+	LayoutParams lp;
+	lp.size = params.size;
+	lp.maxWidth = params.width;
+	layout.layout(*font, segment, lp);
+	for(auto& line : layout.lines) {
+		rows.push_back({start + line.byteStart, start + line.byteEnd});
+	}
+}
+/// The text of _row_ truncated to maxColumns codepoints
+string TextView::rowText(uint row) const {
+	auto& r = rows[row];
+	uint columns = 0;
+	uint i = r.byteStart;
+	for(; i < r.byteEnd; i++) {
+		bool leadByte = ((ubyte)document[i] & 0xc0) != 0x80;
+		if(leadByte && columns++ == params.maxColumns) break;
+	}
+	return document.substr(r.byteStart, i - r.byteStart);
+}
+
+} /// dx11
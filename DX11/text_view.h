@@ -0,0 +1,78 @@
+#pragma once
+///
+///	Scrolling view of a large, growing UTF-8 document (eg. a log).
+///
+///	The document is kept in one contiguous buffer. As text is appended the line index
+///	(byte offset of each line) and the row index (the wrapped lines that are displayed)
+///	are extended incrementally: only the appended text and the unfinished last row are
+///	scanned and wrapped. Rows are wrapped with TextLayout when _width_ > 0.
+///
+///	Only the rows in the visible window are passed to Text, one chunk per row, so the
+///	glyph budget is visibleRows * maxColumns whatever the size of the document. Rows
+///	longer than _maxColumns_ codepoints are truncated.
+///
+namespace dx11 {
+
+struct TextViewParams final {
+	float x = 0, y = 0;
+	float width = 0;			/// 0 = do not wrap
+	float height = 0;
+	float size = 0;				/// 0 = the font's own size
+	float lineSpacing = 1;
+	uint maxColumns = 256;
+	rgba colour = rgba{1, 1, 1, 1};
+};
+
+class TextView final {
+	struct Row final {
+		uint byteStart, byteEnd;
+	};
+	TextViewParams params;
+	Font* font = nullptr;
+	Text text;
+	TextLayout layout;			/// scratch for wrapping
+
+	string document;
+	vector<uint> lineStarts;	/// byte offset of each line
+	vector<Row> rows;
+	uint firstRow = 0;
+	uint visibleRows = 0;
+	float rowHeight = 0;
+	bool followTail = true;		/// keep the last row in view as text is appended
+	bool windowChanged = true;
+public:
+	TextView& init(DX11& dx11, Font* font, const TextViewParams& params);
+	TextView& camera(Camera& cam) {
+		text.camera(cam);
+		return *this;
+	}
+	/// _str_ may contain any number of newlines
+	TextView& append(const string& str);
+	TextView& clear();
+
+	TextView& scrollTo(uint row);
+	TextView& scrollBy(int rows);
+	TextView& scrollToEnd();
+	TextView& scrollToLine(uint line) { return scrollTo(rowOfLine(line)); }
+
+	const string& getDocument() const { return document; }
+	uint numLines() const { return (uint)lineStarts.size(); }
+	uint numRows() const { return (uint)rows.size(); }
+	uint getFirstRow() const { return firstRow; }
+	uint getVisibleRows() const { return visibleRows; }
+	/// The row containing the start of _line_
+	uint rowOfLine(uint line) const;
+
+	void update(const FrameResource& frame);
+	void render(const FrameResource& frame) {
+		text.render(frame);
+	}
+private:
+	void addRows(uint start, uint end);
+	uint lastFirstRow() const {
+		return rows.size() > visibleRows ? (uint)rows.size() - visibleRows : 0;
+	}
+	string rowText(uint row) const;
+};
+
+} /// dx11
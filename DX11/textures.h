@@ -42,6 +42,53 @@ public:
 
 		throwOnDXError(device->CreateShaderResourceView(texture.Get(), &srvdesc, srv.GetAddressOf()));
 	}
+	/// Update a sub-rectangle of mip 0
+	void write(ComPtr<ID3D11DeviceContext> context, uint2 pos, uint2 size, const void* data, uint rowPitch) {
+		D3D11_BOX box = {pos.x, pos.y, 0, pos.x + size.x, pos.y + size.y, 1};
+		context->UpdateSubresource(texture.Get(), 0, &box, data, rowPitch, 0);
+	}
+};
+//================================================================================ Texture2DArray
+class Texture2DArray final {
+public:
+	ComPtr<ID3D11Texture2D> texture;
+	ComPtr<ID3D11ShaderResourceView> srv;
+	uint2 size;
+	uint arraySize = 0;
+
+	void init(ComPtr<ID3D11Device> device, uint2 size, uint arraySize, DXGI_FORMAT format) {
+		this->size = size;
+		this->arraySize = arraySize;
+
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = size.x;
+		desc.Height = size.y;
+		desc.MipLevels = 1;
+		desc.ArraySize = arraySize;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE::D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_FLAG::D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+
+		throwOnDXError(device->CreateTexture2D(&desc, nullptr, texture.GetAddressOf()));
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvdesc = {};
+		srvdesc.Format = format;
+		srvdesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvdesc.Texture2DArray.MipLevels = 1;
+		srvdesc.Texture2DArray.FirstArraySlice = 0;
+		srvdesc.Texture2DArray.ArraySize = arraySize;
+
+		throwOnDXError(device->CreateShaderResourceView(texture.Get(), &srvdesc, srv.GetAddressOf()));
+	}
+	/// Copy mip 0 of _src_ (same format, no bigger than a slice) to the top left of _slice_
+	void copyToSlice(ComPtr<ID3D11DeviceContext> context, uint slice, const Texture2D& src, uint2 srcSize) {
+		D3D11_BOX box = {0, 0, 0, srcSize.x, srcSize.y, 1};
+		context->CopySubresourceRegion(texture.Get(), D3D11CalcSubresource(0, slice, 1), 0, 0, 0, src.texture.Get(), 0, &box);
+	}
 };
 //================================================================================ RWTexture2D
 class RWTexture2D final {
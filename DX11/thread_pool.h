@@ -0,0 +1,98 @@
+#pragma once
+///
+///	Fixed size pool of worker threads.
+///
+///	submit() queues a single task and returns a future for its result.
+///	parallelFor() splits an index range into chunks and runs them on the workers and the
+///	calling thread. It blocks until every chunk is done so it must not be called from
+///	inside a pool task. Its chunks also wait behind any tasks already queued, so slow
+///	submit() tasks such as file loads belong in a different pool.
+///
+namespace dx11 {
+
+class ThreadPool final {
+	vector<std::thread> threads;
+	std::deque<std::function<void()>> queue;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+public:
+	/// 0 = one thread per hardware thread, less one for the calling thread.
+	/// hardware_concurrency() may return 0 if it is unknown
+	explicit ThreadPool(uint numThreads = 0) {
+		if(numThreads == 0) numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+		threads.reserve(numThreads);
+		for(uint i = 0; i < numThreads; i++) {
+			threads.emplace_back([this] { run(); });
+		}
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(auto& t : threads) t.join();
+	}
+	uint size() const { return (uint)threads.size(); }
+
+	template<typename F>
+	auto submit(F&& f) -> std::future<decltype(f())> {
+		/// std::function needs a copyable callable
+		auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+		auto future = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.emplace_back([task] { (*task)(); });
+		}
+		wake.notify_one();
+		return future;
+	}
+	///
+	///	Call f(uint begin, uint end) over [0, count) in chunks of at least _minPerTask_ indexes.
+	///	The calling thread runs the first chunk. Exceptions thrown by f are rethrown here.
+	///
+	template<typename F>
+	void parallelFor(uint count, uint minPerTask, F&& f) {
+		if(count == 0) return;
+		minPerTask = std::max(1u, minPerTask);
+		uint numTasks = std::min(size() + 1, (count + minPerTask - 1) / minPerTask);
+		if(numTasks <= 1) {
+			f(0u, count);
+			return;
+		}
+		uint perTask = (count + numTasks - 1) / numTasks;
+
+		vector<std::future<void>> futures;
+		futures.reserve(numTasks - 1);
+		for(uint begin = perTask; begin < count; begin += perTask) {
+			uint end = std::min(count, begin + perTask);
+			futures.push_back(submit([&f, begin, end] { f(begin, end); }));
+		}
+		/// Wait for every chunk before rethrowing because the tasks reference f
+		std::exception_ptr error;
+		try { f(0u, perTask); } catch(...) { error = std::current_exception(); }
+		for(auto& fut : futures) {
+			try { fut.get(); } catch(...) { if(!error) error = std::current_exception(); }
+		}
+		if(error) std::rethrow_exception(error);
+	}
+private:
+	void run() {
+		while(true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !queue.empty(); });
+				if(stopping && queue.empty()) return;
+				task = std::move(queue.front());
+				queue.pop_front();
+			}
+			task();
+		}
+	}
+};
+
+} /// dx11
@@ -23,6 +23,12 @@ struct rgba final {
 	rgba() = default;
 	constexpr rgba(float r, float g, float b, float a) : r(r), g(g), b(b), a(a) {}
 	constexpr rgba(const float4& f) : r(f.x), g(f.y), b(f.z), a(f.w) {}
+
+	/// Pack to DXGI_FORMAT_R8G8B8A8_UNORM
+	uint toRGBA8() const {
+		const auto f = [](float v) { return (uint)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+		return f(r) | (f(g) << 8) | (f(b) << 16) | (f(a) << 24);
+	}
 };
 ///================================================================================= Rect
 struct Rect final {
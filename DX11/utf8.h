@@ -0,0 +1,97 @@
+#pragma once
+///
+///	UTF-8 decoding to codepoints.
+///
+///	Runs of ASCII are handled 16 bytes at a time using SSE2.
+///	Every byte that is not a continuation byte (10xxxxxx) starts exactly one codepoint so
+///	count() always agrees with the number of codepoints produced by forEach().
+///	Malformed sequences decode to U+FFFD and stray continuation bytes are skipped.
+///
+namespace dx11::utf8 {
+
+constexpr uint REPLACEMENT = 0xfffd;
+
+inline bool isContinuation(ubyte b) { return (b & 0xc0) == 0x80; }
+
+/// Decode the non-ASCII sequence starting at _p_ and advance _p_ past it
+inline uint decodeSequence(const char*& p, const char* end) {
+	ubyte lead = (ubyte)*p++;
+	uint cp, length;
+	if((lead & 0xe0) == 0xc0)      { cp = lead & 0x1f; length = 2; }
+	else if((lead & 0xf0) == 0xe0) { cp = lead & 0x0f; length = 3; }
+	else if((lead & 0xf8) == 0xf0) { cp = lead & 0x07; length = 4; }
+	else {
+		/// Invalid lead byte. Skip any continuation bytes that follow it
+		while(p < end && isContinuation((ubyte)*p)) p++;
+		return REPLACEMENT;
+	}
+	uint i = 1;
+	for(; i < length && p < end && isContinuation((ubyte)*p); i++) {
+		cp = (cp << 6) | ((ubyte)*p++ & 0x3f);
+	}
+	if(i < length) return REPLACEMENT;
+
+	/// Reject overlong encodings, surrogates and out of range values
+	static constexpr uint MIN[5] = {0, 0, 0x80, 0x800, 0x10000};
+	if(cp < MIN[length] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) return REPLACEMENT;
+	return cp;
+}
+/// Call f(uint codepoint, uint begin, uint end) for every codepoint in [start, end) where
+/// begin and end are the byte offsets of the codepoint relative to _start_
+template<typename F>
+inline void forEachOffset(const char* start, const char* end, F&& f) {
+	const char* p = start;
+	while(p < end) {
+		/// ASCII fast path
+		while(end - p >= 16) {
+			__m128i v = _mm_loadu_si128((const __m128i*)p);
+			if(_mm_movemask_epi8(v) != 0) break;
+			uint offset = (uint)(p - start);
+			for(uint i = 0; i < 16; i++) f((uint)p[i], offset + i, offset + i + 1);
+			p += 16;
+		}
+		if(p >= end) break;
+
+		ubyte b = (ubyte)*p;
+		uint offset = (uint)(p - start);
+		if(b < 0x80) {
+			p++;
+			f((uint)b, offset, offset + 1);
+		} else if(isContinuation(b)) {
+			p++;
+		} else {
+			uint cp = decodeSequence(p, end);
+			f(cp, offset, (uint)(p - start));
+		}
+	}
+}
+/// Call f(uint codepoint) for every codepoint in [p, end)
+template<typename F>
+inline void forEach(const char* p, const char* end, F&& f) {
+	forEachOffset(p, end, [&f](uint cp, uint, uint) { f(cp); });
+}
+template<typename F>
+inline void forEach(const string& text, F&& f) {
+	forEach(text.data(), text.data() + text.size(), std::forward<F>(f));
+}
+/// Number of codepoints in [p, end)
+inline uint count(const char* p, const char* end) {
+	uint total = 0;
+	/// As signed bytes, continuation bytes are -128..-65
+	const __m128i limit = _mm_set1_epi8(-64);
+	while(end - p >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)p);
+		uint continuations = (uint)_mm_movemask_epi8(_mm_cmplt_epi8(v, limit));
+		total += 16 - std::popcount(continuations);
+		p += 16;
+	}
+	for(; p < end; p++) {
+		if(!isContinuation((ubyte)*p)) total++;
+	}
+	return total;
+}
+inline uint count(const string& text) {
+	return count(text.data(), text.data() + text.size());
+}
+
+} /// dx11::utf8
@@ -0,0 +1,26 @@
+/**
+ *	Animation evaluated against the frame time (see DX11/animation.h).
+ *
+ *	#include "animation_inc.hlsl" and add an AnimInput parameter to the vertex shader.
+ *	The data comes from vertex stream 1.
+ */
+struct AnimInput {
+	float2 times    : ANIMTIME;		// start, reveal
+	float2 velocity : VELOCITY;		// pixels per second
+	float4 colour   : RAMPCOLOR;
+	float2 ramp     : RAMP;			// duration, ping pong
+};
+
+bool animIsHidden(AnimInput a, float time) {
+	return time < a.times.y;
+}
+float2 animOffset(AnimInput a, float time) {
+	return a.velocity * max(time - a.times.x, 0);
+}
+float4 animColour(float4 colour, AnimInput a, float time) {
+	if(a.ramp.x <= 0) return colour;
+	float t = max(time - a.times.x, 0) / a.ramp.x;
+	// Triangle wave 0 -> 1 -> 0 with a period of two ramps
+	if(a.ramp.y > 0) t = 1 - abs(frac(t * 0.5) * 2 - 1);
+	return lerp(colour, a.colour, saturate(t));
+}
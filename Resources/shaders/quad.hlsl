@@ -1,12 +1,25 @@
 
 cbuffer MatrixBuffer : register(b0) {
 	matrix viewProj;
+	float time;		// seconds, for VSMainAnimated
+	float3 _pad;
 };
+#include "animation_inc.hlsl"
+
 struct VSInput {
 	float2 position	: POSITION;
 	float4 color	: COLOR;
 	float2 uv		: TEXCOORD;
 };
+/// Instanced: one Info per quad. The corners come from SV_VertexID
+struct VSInstanceInput {
+	float2 position	 : POSITION;
+	float2 dimension : DIMENSION;
+	float4 uv		 : TEXCOORD;	// u, v, u2, v2
+	float4 color	 : COLOR;
+	float rotation   : ROTATION;	// radians about the centre
+	uint vertexId    : SV_VertexID;
+};
 struct PSInput {
 	float4 position : SV_POSITION;
 	float4 color	: COLOR;
@@ -23,6 +36,40 @@ PSInput VSMain(VSInput input) {
 	result.uv       = input.uv;
 	return result;
 }
+/// 0 --- 1
+/// | \   |
+/// |   \ |
+/// 3 --- 2
+static const float2 CORNERS[6] = {
+	float2(0, 0), float2(1, 0), float2(1, 1),
+	float2(0, 0), float2(1, 1), float2(0, 1)
+};
+PSInput VSMainInstanced(VSInstanceInput input) {
+	float2 corner = CORNERS[input.vertexId];
+	float2 d      = (corner - 0.5) * input.dimension;
+	float s, c;
+	sincos(input.rotation, s, c);
+
+	VSInput v;
+	v.position = input.position + input.dimension * 0.5 + float2(d.x*c - d.y*s, d.x*s + d.y*c);
+	v.uv       = lerp(input.uv.xy, input.uv.zw, corner);
+	v.color    = input.color;
+	return VSMain(v);
+}
+PSInput VSMainAnimated(VSInput input, AnimInput anim) {
+	input.position += animOffset(anim, time);
+	input.color     = animColour(input.color, anim, time);
+	PSInput result  = VSMain(input);
+	if(animIsHidden(anim, time)) result.position = 0;
+	return result;
+}
+PSInput VSMainInstancedAnimated(VSInstanceInput input, AnimInput anim) {
+	input.position += animOffset(anim, time);
+	input.color     = animColour(input.color, anim, time);
+	PSInput result  = VSMainInstanced(input);
+	if(animIsHidden(anim, time)) result.position = 0;
+	return result;
+}
 float4 PSMain(PSInput input) : SV_TARGET {
 	return texture1.Sample(sampler1, input.uv) * input.color;
 }
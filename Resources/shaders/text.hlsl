@@ -2,23 +2,50 @@
 cbuffer MatrixBuffer : register(b0) {
 	matrix c_viewProj;
 	float4 c_dsColour;
+	float4 c_outlineColour;
 	float2 c_dsOffset;
+	float c_outlineWidth;		// in distance field units (0 to 0.5)
+	float c_outlineSoftness;	// > 0 turns the outline into a glow
+	float c_dsEnabled;			// 1 if PSMainCombined should draw the drop shadow
+	float c_time;				// seconds, for the Animated vertex shaders
 	float2 _pad;
 };
+#include "animation_inc.hlsl"
+
 struct VSInput {
 	float2 position	: POSITION;
 	float2 uv		: TEXCOORD;
 	float4 color	: COLOR;
 	float size      : SIZE;
+	float4 uvRect   : UVRECT;
+};
+struct VSInstanceInput {
+	float2 position	 : POSITION;
+	float2 dimension : DIMENSION;
+	float4 uv		 : TEXCOORD;	// u, v, u2, v2
+	float4 color	 : COLOR;
+	float size       : SIZE;
+	uint vertexId    : SV_VertexID;
 };
 struct PSInput {
 	float4 position : SV_POSITION;
 	float4 color	: COLOR;
 	float2 uv	    : TEXCOORD;
 	float size	    : SIZE;
+	nointerpolation float4 uvRect : UVRECT;	// glyph bounds in the atlas
+#ifdef TEXT_BATCH
+	nointerpolation uint layer : LAYER;		// font slice of the atlas array
+#endif
 };
 
+#ifdef TEXT_BATCH
+/// TextBatch: one slice per font
+Texture2DArray texture1 : register(t0);
+#define SAMPLE_ATLAS(uv, input) texture1.Sample(sampler1, float3(uv, input.layer)).r
+#else
 Texture2D texture1    : register(t0);
+#define SAMPLE_ATLAS(uv, input) texture1.Sample(sampler1, uv).r
+#endif
 SamplerState sampler1 : register(s0);
 
 PSInput VSMain(VSInput input) {
@@ -27,19 +54,122 @@ PSInput VSMain(VSInput input) {
 	result.color    = input.color;
 	result.uv       = input.uv;
 	result.size     = input.size;
+	result.uvRect   = input.uvRect;
+	return result;
+}
+/// 0 --- 1
+/// | \   |
+/// |   \ |
+/// 3 --- 2
+static const float2 CORNERS[6] = {
+	float2(0, 0), float2(1, 0), float2(1, 1),
+	float2(0, 0), float2(1, 1), float2(0, 1)
+};
+PSInput VSMainInstanced(VSInstanceInput input) {
+	float2 corner = CORNERS[input.vertexId];
+
+	// Grow the quad to cover the drop shadow
+	float2 uvSize      = input.uv.zw - input.uv.xy;
+	float2 pixelsPerUV = uvSize > 0 ? input.dimension / max(uvSize, 1e-6) : 0;
+	float2 pad         = c_dsEnabled * abs(c_dsOffset);
+	float2 position    = input.position - pad * pixelsPerUV;
+	float2 dimension   = input.dimension + 2 * pad * pixelsPerUV;
+
+	PSInput result;
+	result.position = mul(c_viewProj, float4(position + corner * dimension, 0, 1));
+	result.color    = input.color;
+	result.uv       = lerp(input.uv.xy - pad, input.uv.zw + pad, corner);
+	result.size     = input.size;
+	result.uvRect   = input.uv;
+	return result;
+}
+/// Animated variants. Hidden glyphs are collapsed to a point
+PSInput VSMainAnimated(VSInput input, AnimInput anim) {
+	input.position += animOffset(anim, c_time);
+	input.color     = animColour(input.color, anim, c_time);
+	PSInput result  = VSMain(input);
+	if(animIsHidden(anim, c_time)) result.position = 0;
+	return result;
+}
+PSInput VSMainInstancedAnimated(VSInstanceInput input, AnimInput anim) {
+	input.position += animOffset(anim, c_time);
+	input.color     = animColour(input.color, anim, c_time);
+	PSInput result  = VSMainInstanced(input);
+	if(animIsHidden(anim, c_time)) result.position = 0;
 	return result;
 }
+#ifdef TEXT_BATCH
+PSInput VSMainBatch(VSInstanceInput input, uint layer : LAYER) {
+	PSInput result = VSMainInstanced(input);
+	result.layer   = layer;
+	return result;
+}
+#endif
+/// GpuText: glyph instances written by text_layout.hlsl
+struct GlyphInstance {
+	float2 position;
+	float2 dimension;
+	uint2 uv;			// 4 x unorm16
+	uint colour;		// rgba8
+	float size;
+};
+StructuredBuffer<GlyphInstance> glyphInstances : register(t1);
+
+PSInput VSMainGpu(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID) {
+	GlyphInstance g = glyphInstances[instanceId];
+
+	VSInstanceInput input;
+	input.position  = g.position;
+	input.dimension = g.dimension;
+	input.uv        = float4(g.uv.x & 0xffff, g.uv.x >> 16, g.uv.y & 0xffff, g.uv.y >> 16) / 65535.0;
+	input.color     = float4(g.colour & 0xff, (g.colour >> 8) & 0xff, (g.colour >> 16) & 0xff, g.colour >> 24) / 255.0;
+	input.size      = g.size;
+	input.vertexId  = vertexId;
+	return VSMainInstanced(input);
+}
 float4 PSMain(PSInput input) : SV_TARGET {
 	float smoothing = (1.0 / (0.25*input.size));
-	float distance  = texture1.Sample(sampler1, input.uv).r;
+	float distance  = SAMPLE_ATLAS(input.uv, input);
 	float alpha     = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
 	return float4(input.color.rgb, input.color.a * alpha);
 }
 float4 PSMainDropShadow(PSInput input) : SV_TARGET {
 	float2 offset = c_dsOffset;
 	float smoothing = (1.0 / (0.25*input.size)) * input.size / 12;
-	float distance = texture1.Sample(sampler1, input.uv - offset).r;
+	float distance = SAMPLE_ATLAS(input.uv - offset, input);
 	float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
 	float4 col = c_dsColour;
 	return float4(col.rgb, col.a * alpha);
 }
+/// Distance outside the glyph's own rectangle is treated as empty so that expanded
+/// quads do not pick up neighbouring glyphs
+float sampleDistance(float2 uv, PSInput input) {
+	if(any(uv < input.uvRect.xy) || any(uv > input.uvRect.zw)) return 0;
+	return SAMPLE_ATLAS(uv, input);
+}
+/// Drop shadow, outline/glow and fill in one pass, composited back to front
+float4 PSMainCombined(PSInput input) : SV_TARGET {
+	float smoothing = (1.0 / (0.25*input.size));
+	float distance  = sampleDistance(input.uv, input);
+	float fill      = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+
+	float outline = 0;
+	if(c_outlineWidth > 0) {
+		float edge = 0.5 - c_outlineWidth;
+		outline = smoothstep(edge - smoothing - c_outlineSoftness, edge + smoothing, distance);
+	}
+
+	float dsSmoothing = smoothing * input.size / 12;
+	float dsDistance  = sampleDistance(input.uv - c_dsOffset, input);
+	float shadow      = c_dsEnabled * smoothstep(0.5 - dsSmoothing, 0.5 + dsSmoothing, dsDistance);
+
+	// Premultiplied 'over'
+	float4 result = float4(c_dsColour.rgb, 1) * (c_dsColour.a * shadow);
+	float4 o      = float4(c_outlineColour.rgb, 1) * (c_outlineColour.a * outline);
+	result = o + result * (1 - o.a);
+	float4 f = float4(input.color.rgb, 1) * (input.color.a * fill);
+	result = f + result * (1 - f.a);
+
+	// The blend state expects straight alpha
+	return result.a > 0 ? float4(result.rgb / result.a, result.a) : 0;
+}
@@ -0,0 +1,139 @@
+/// Lays out GpuText glyphs from codepoints.
+///
+/// One thread group per chunk. The group walks its chunk GROUP_SIZE codepoints at a time,
+/// prefix sums the advances (plus kerning) to get each glyph's pen position and compacts
+/// the visible glyphs into the instance buffer. Each tile reserves its instances with one
+/// atomic add on the instance count of the indirect draw arguments.
+
+#define GROUP_SIZE 256
+
+struct Chunk {
+	float2 origin;
+	float size;
+	uint colour;
+	uint firstCodepoint;
+	uint numCodepoints;
+	uint2 _pad;
+};
+struct Glyph {
+	float4 uv;			// u, v, u2, v2
+	float2 offset;
+	float2 dimension;
+	float advance;
+	float3 _pad;
+};
+struct KerningPair {
+	uint first;
+	uint second;
+	int amount;
+};
+struct GlyphInstance {
+	float2 position;
+	float2 dimension;
+	uint2 uv;			// 4 x unorm16
+	uint colour;
+	float size;
+};
+
+cbuffer Constants : register(b0) {
+	uint c_numChunks;
+	uint c_numGlyphs;			// glyphs[c_numGlyphs] is the fallback glyph
+	uint c_numKerningPairs;
+	float c_fontSize;
+};
+
+StructuredBuffer<Chunk> chunks          : register(t0);
+ByteAddressBuffer codepoints            : register(t1);
+StructuredBuffer<uint> glyphIds         : register(t2);	// sorted
+StructuredBuffer<Glyph> glyphs          : register(t3);
+StructuredBuffer<KerningPair> kerning   : register(t4);	// sorted by (first, second)
+
+RWStructuredBuffer<GlyphInstance> instances : register(u0);
+RWBuffer<uint> drawArgs                     : register(u1);
+
+groupshared float gs_pen[GROUP_SIZE];
+groupshared uint gs_visible[GROUP_SIZE];
+groupshared uint gs_base;
+
+uint findGlyph(uint ch) {
+	uint lo = 0, hi = c_numGlyphs;
+	while(lo < hi) {
+		uint mid = (lo + hi) / 2;
+		if(glyphIds[mid] < ch) lo = mid + 1; else hi = mid;
+	}
+	return (lo < c_numGlyphs && glyphIds[lo] == ch) ? lo : c_numGlyphs;
+}
+int getKerning(uint first, uint second) {
+	uint lo = 0, hi = c_numKerningPairs;
+	while(lo < hi) {
+		uint mid = (lo + hi) / 2;
+		KerningPair p = kerning[mid];
+		if(p.first < first || (p.first == first && p.second < second)) lo = mid + 1; else hi = mid;
+	}
+	if(lo < c_numKerningPairs && kerning[lo].first == first && kerning[lo].second == second) {
+		return kerning[lo].amount;
+	}
+	return 0;
+}
+uint packUnorm16(float a, float b) {
+	return (uint)(saturate(a) * 65535 + 0.5) | ((uint)(saturate(b) * 65535 + 0.5) << 16);
+}
+
+[numthreads(GROUP_SIZE, 1, 1)]
+void CSMain(uint3 groupId : SV_GroupID, uint threadId : SV_GroupIndex) {
+	Chunk chunk = chunks[groupId.x];
+	float ratio = chunk.size / c_fontSize;
+	float carry = 0;
+
+	for(uint tile = 0; tile < chunk.numCodepoints; tile += GROUP_SIZE) {
+		uint i      = tile + threadId;
+		bool valid  = i < chunk.numCodepoints;
+		Glyph g     = (Glyph)0;
+		float step  = 0;
+
+		if(valid) {
+			uint ch = codepoints.Load((chunk.firstCodepoint + i) * 4);
+			g = glyphs[findGlyph(ch)];
+			if(i > 0) {
+				uint prev = codepoints.Load((chunk.firstCodepoint + i - 1) * 4);
+				step = glyphs[findGlyph(prev)].advance + getKerning(prev, ch);
+			}
+		}
+		bool visible = valid && g.dimension.x > 0 && g.dimension.y > 0;
+
+		// Inclusive scan of the pen steps and the visible flags
+		gs_pen[threadId]     = step * ratio;
+		gs_visible[threadId] = visible ? 1 : 0;
+		GroupMemoryBarrierWithGroupSync();
+
+		[unroll]
+		for(uint offset = 1; offset < GROUP_SIZE; offset <<= 1) {
+			float pen   = threadId >= offset ? gs_pen[threadId - offset] : 0;
+			uint  count = threadId >= offset ? gs_visible[threadId - offset] : 0;
+			GroupMemoryBarrierWithGroupSync();
+			gs_pen[threadId]     += pen;
+			gs_visible[threadId] += count;
+			GroupMemoryBarrierWithGroupSync();
+		}
+
+		if(threadId == GROUP_SIZE - 1) {
+			InterlockedAdd(drawArgs[1], gs_visible[GROUP_SIZE - 1], gs_base);
+		}
+		GroupMemoryBarrierWithGroupSync();
+
+		if(visible) {
+			float x = chunk.origin.x + carry + gs_pen[threadId] + g.offset.x * ratio;
+			float y = chunk.origin.y + g.offset.y * ratio;
+
+			GlyphInstance inst;
+			inst.position  = float2(x, y);
+			inst.dimension = g.dimension * ratio;
+			inst.uv        = uint2(packUnorm16(g.uv.x, g.uv.y), packUnorm16(g.uv.z, g.uv.w));
+			inst.colour    = chunk.colour;
+			inst.size      = chunk.size;
+			instances[gs_base + gs_visible[threadId] - 1] = inst;
+		}
+		carry += gs_pen[GROUP_SIZE - 1];
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
@@ -6,4 +6,12 @@
 #include "eg_3d.h"
 #include "eg_compute.h"
 #include "eg_compute_to_texture.h"
-#include "eg_shader_printf.h"
\ No newline at end of file
+#include "eg_shader_printf.h"
+#include "eg_kerning_benchmark.h"
+#include "eg_sdf_generator.h"
+#include "eg_dynamic_font.h"
+#include "eg_gpu_text.h"
+#include "eg_text_view.h"
+#include "eg_text_batch.h"
+#include "eg_tile_map.h"
+#include "eg_quad_benchmark.h"
\ No newline at end of file
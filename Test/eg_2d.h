@@ -29,7 +29,10 @@ class Example2D final : public BaseExample {
 	Camera2D camera2d;
 
 	Quad quad1;
+	QuadHandle spinner;
     Text text;
+	Text animatedText;
+	Text panelText;
 	int mouseScroll = 0;
 public:
 	void init(HINSTANCE hInstance, int cmdShow) final override {
@@ -43,24 +46,70 @@ public:
 	void setup() final override {
 		Log::format("Application setup");
 
+		/// Load the font while the rest of the pipeline is set up
+		auto font = dx11.fonts.getAsync(L"segoe-ui-black");
+
 		camera2d.init(dx11.windowSize());
 		Log::format("camera2d: %s", camera2d.toString().c_str());
 
 		setupPipeline();
 
-		quad1.init(dx11, 10)
+		Animation pulse;
+		pulse.rampColour = rgba{1, 0.5f, 0.5f, 0.5f};
+		pulse.rampDuration = 1;
+		pulse.pingPong = true;
+		pulse.revealInterval = 0.5f;
+
+		quad1.enableAnimation()
+			.init(dx11, 10, true)
 			.camera(camera2d)
 			.color({1, 1, 1, 1})
+			.animation(pulse)
 			.sampler(sampler1)
 			.texture(texture0.srv)
 			.quad({450,250}, {100,100})
-			.quad({560,250}, {150,150});
+			.quad({560,250}, {150,150})
+			/// Rotated quarters of the same texture. Still one draw call
+			.uv({0, 0, 0.5f, 0.5f})
+			.quad({750,250}, {100,100}, 0.3f)
+			.uv({0.5f, 0.5f, 1, 1})
+			.quad({870,250}, {100,100}, -0.3f);
+		/// Rotated every frame through its handle. Only this quad is uploaded
+		spinner = quad1.uv({0, 0, 1, 1}).add({990,250}, {100,100});
 
-        text.init(dx11, dx11.fonts.get(L"segoe-ui-black"), true, 100)
+        text.init(dx11, font.get(), true, 100)
             .camera(camera2d)
             .setSize(32)
+            .setOutline({0.2f, 0.4f, 1, 1}, 0.1f)
             .appendText("I am some text 1234567890", 320, 2);
 
+		/// Typewriter reveal that then drifts and fades. No uploads after the first frame
+		Animation typewriter;
+		typewriter.delay = 1;
+		typewriter.revealInterval = 0.05f;
+		typewriter.velocity = float2{0, 4};
+		typewriter.rampColour = rgba{1, 1, 1, 0};
+		typewriter.rampDuration = 10;
+
+		animatedText.enableAnimation()
+			.init(dx11, font.get(), false, 100, true)
+			.camera(camera2d)
+			.setSize(24)
+			.setAnimation(typewriter)
+			.appendText("Animated on the GPU...", 320, 60);
+
+		/// Two scrolled lists clipped to their panels. Both are drawn with one draw call
+		panelText.init(dx11, font.get(), false, 1024, true)
+			.camera(camera2d)
+			.setSize(20);
+		for(uint p = 0; p < 2; p++) {
+			int px = 20 + (int)p * 220;
+			panelText.setClipRect({(float)px, 400, 200, 130});
+			for(uint i = 0; i < 8; i++) {
+				panelText.appendText(String::format("Panel %u, line %u of the list", p, i), px, 388 + (int)i * 22);
+			}
+		}
+
 		Log::format("Application setup finished");
 	}
 	void mouseWheel(int delta, KeyMod mod) final override {
@@ -89,8 +138,11 @@ public:
 		if(cameraMoved) {
 			quad1.camera(camera2d);
 		}
+		quad1.setRotation(spinner, (float)(frame.nsecs * 1e-9));
 		quad1.update(frame);
         text.update(frame);
+		animatedText.update(frame);
+		panelText.update(frame);
 	}
 	void render(const FrameResource& frame) final override {
 		auto context = frame.context;
@@ -121,6 +173,8 @@ public:
 
 		quad1.render(frame);
         text.render(frame);
+		animatedText.render(frame);
+		panelText.render(frame);
 	}
 private:
 	void setupPipeline() {
@@ -28,7 +28,8 @@ public:
 
 		camera2d.init(dx11.windowSize());
 
-		text.init(dx11, dx11.fonts.get(L"arial"), true, 256)
+		text.setUsage(TextUsage::STATIC)
+			.init(dx11, dx11.fonts.get(L"arial"), true, 256)
 			.camera(camera2d)
 			.setSize(128)
 			.setColour({0.498039246f, 1.000000000f, 0.831372619f, 1.000000000f})
@@ -0,0 +1,69 @@
+#pragma once
+///
+///	Text using a TrueType font whose glyphs are rasterised into the atlas on first use.
+///	The atlas is deliberately small so that glyph pages are evicted as the text changes.
+///
+class ExampleDynamicFont final : public BaseExample {
+	Camera2D camera2d;
+	Text text;
+	Font* font = nullptr;
+	uint first = 0x4e00;	/// CJK unified ideographs
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Dynamic Font";
+		params.width = 1000;
+		params.height = 400;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		GlyphCacheParams gcp;
+		gcp.size = 48;
+		gcp.pageSize = 256;
+		gcp.numPages = 2;
+		font = dx11.fonts.getTrueType(L"", L"MS Gothic", gcp);
+
+		text.init(dx11, font, true, 256)
+			.camera(camera2d)
+			.setSize(48)
+			.appendText("Dynamic atlas", 20, 20)
+			.appendText(ideographs(), 20, 120)
+			.appendText("", 20, 300);
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		/// Scroll through the ideographs twice a second
+		if(frame.number % 30 == 0) {
+			first = first >= 0x9f00 ? 0x4e00 : first + 16;
+			text.replaceText(1, ideographs());
+			text.replaceText(2, String::format("rasterised %llu evictions %llu",
+							 font->glyphCache->rasterised, font->glyphCache->evictions));
+		}
+		text.update(frame);
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.1f, 0.2f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		text.render(frame);
+	}
+private:
+	/// 16 ideographs starting at _first_ as UTF-8
+	string ideographs() const {
+		string s;
+		for(uint ch = first; ch < first + 16; ch++) {
+			s += (char)(0xe0 | (ch >> 12));
+			s += (char)(0x80 | ((ch >> 6) & 0x3f));
+			s += (char)(0x80 | (ch & 0x3f));
+		}
+		return s;
+	}
+};
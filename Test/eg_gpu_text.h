@@ -0,0 +1,97 @@
+#pragma once
+///
+///	A scrolling log laid out on the GPU. Each frame one line is rewritten, which uploads
+///	only that line's codepoints. Every few seconds the GPU instances are read back and
+///	diffed against the CPU reference layout.
+///
+///	Below the log a few lines of ideographs use a dynamic font whose atlas only just holds
+///	them. Only the top line is rewritten, so its new glyphs evict the pages the other
+///	lines are using and GpuText has to prepare those lines again.
+///
+class ExampleGpuText final : public BaseExample {
+	Camera2D camera2d;
+	GpuText text, dynamicText;
+	static constexpr uint NUM_LINES = 40;
+	static constexpr uint LINE_HEIGHT = 15;
+	static constexpr uint NUM_DYNAMIC_LINES = 4;
+	ulong lineNumber = 0;
+	uint first = 0x4e00;		/// first ideograph of the next dynamic line
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 GPU Text Layout";
+		params.width = 1000;
+		params.height = 760;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		text.init(dx11, dx11.fonts.get(L"arial"), false, 64 * 1024, NUM_LINES)
+			.camera(camera2d)
+			.setSize(14);
+		for(uint i = 0; i < NUM_LINES; i++) {
+			text.appendText(logLine(), 10, (float)(10 + i * LINE_HEIGHT));
+		}
+
+		GlyphCacheParams gcp;
+		gcp.pageSize = 256;
+		gcp.numPages = 2;
+		dynamicText.init(dx11, dx11.fonts.getTrueType(L"", L"MS Gothic", gcp), false, 1024, NUM_DYNAMIC_LINES)
+			.camera(camera2d)
+			.setSize(28);
+		for(uint i = 0; i < NUM_DYNAMIC_LINES; i++) {
+			dynamicText.appendText(ideographs(), 10, (float)(620 + i * 32));
+		}
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		text.replaceText((uint)(lineNumber % NUM_LINES), logLine());
+		text.update(frame);
+		if(frame.number % 30 == 0) {
+			dynamicText.replaceText(0, ideographs());
+		}
+		dynamicText.update(frame);
+
+		if(frame.number % 300 == 10) {
+			check(frame, text, "GPU layout");
+			check(frame, dynamicText, "GPU layout (dynamic font)");
+		}
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.1f, 0.2f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		text.render(frame);
+		dynamicText.render(frame);
+	}
+private:
+	static void check(const FrameResource& frame, GpuText& t, const char* name) {
+		vector<GpuText::GlyphInstance> gpu, cpu;
+		t.readback(frame.context, gpu);
+		t.layoutCPU(cpu);
+		Log::format("%s: %u glyphs, %u differ from the CPU layout", name, (uint)gpu.size(), GpuText::compare(gpu, cpu));
+	}
+	/// The next 16 ideographs as UTF-8
+	string ideographs() {
+		string s;
+		for(uint ch = first; ch < first + 16; ch++) {
+			s += (char)(0xe0 | (ch >> 12));
+			s += (char)(0x80 | ((ch >> 6) & 0x3f));
+			s += (char)(0x80 | (ch & 0x3f));
+		}
+		first = first >= 0x9f00 ? 0x4e00 : first + 16;
+		return s;
+	}
+	string logLine() {
+		ulong n = lineNumber++;
+		return String::format("[%08llu] worker %llu processed batch %llu: %llu items, checksum %08llx",
+							  n, n % 7, n / 3, (n * 37) % 1000, n * 0x9e3779b97f4a7c15ULL >> 32);
+	}
+};
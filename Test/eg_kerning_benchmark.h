@@ -0,0 +1,76 @@
+#pragma once
+///
+///	Compares FontKerning lookups against the unordered_map<ulong,int> (key = from<<32 | to)
+///	that FontPage used previously. Results are written to the log.
+///
+class ExampleKerningBenchmark final : public BaseExample {
+	static constexpr int ITERATIONS = 1000;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Kerning Benchmark";
+		params.width = 600;
+		params.height = 400;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		benchmark(dx11.fonts.get(L"arial"));
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+	}
+private:
+	void benchmark(Font* font) {
+		unordered_map<ulong, int> map;
+		for(auto& p : font->page.kerning.all()) {
+			map[((ulong)p.first << 32) | p.second] = p.amount;
+		}
+
+		/// Every printable ASCII pair
+		vector<uint> text;
+		for(uint a = 32; a < 127; a++) {
+			for(uint b = 32; b < 127; b++) {
+				text.push_back(a);
+				text.push_back(b);
+			}
+		}
+		ulong numLookups = (ulong)ITERATIONS * (text.size() - 1);
+
+		auto start = high_resolution_clock::now();
+		slong mapTotal = 0;
+		for(int it = 0; it < ITERATIONS; it++) {
+			for(size_t i = 0; i + 1 < text.size(); i++) {
+				auto iter = map.find(((ulong)text[i]) << 32 | text[i + 1]);
+				if(iter != map.end()) mapTotal += iter->second;
+			}
+		}
+		double mapMillis = (high_resolution_clock::now() - start).count() * 1e-6;
+
+		start = high_resolution_clock::now();
+		slong tableTotal = 0;
+		for(int it = 0; it < ITERATIONS; it++) {
+			for(size_t i = 0; i + 1 < text.size(); i++) {
+				tableTotal += font->getKerning(text[i], text[i + 1]);
+			}
+		}
+		double tableMillis = (high_resolution_clock::now() - start).count() * 1e-6;
+
+		Log::format("Kerning benchmark '%s': %u pairs, %llu lookups",
+					WString::toString(font->name).c_str(), font->page.kerning.count(), numLookups);
+		Log::format("\tunordered_map : %.3f ms (total %lld)", mapMillis, mapTotal);
+		Log::format("\tFontKerning   : %.3f ms (total %lld)", tableMillis, tableTotal);
+
+		if(mapTotal != tableTotal) {
+			throw std::runtime_error("Kerning benchmark results do not match");
+		}
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+///
+///	Times the CPU side of a full Quad rebuild (Quad::prepare()) of a million quads on 1 to N
+///	threads. Results are written to the log. The quads are drawn afterwards.
+///
+class ExampleQuadBenchmark final : public BaseExample {
+	static constexpr uint NUM_QUADS = 1000000;
+	static constexpr int REPEATS = 5;
+	Camera2D camera2d;
+	Texture2D white;
+	Sampler sampler;
+	Quad quads;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Quad Benchmark";
+		params.width = 1200;
+		params.height = 800;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		const uint pixel = 0xffffffff;
+		white.init(dx11.device, {1, 1}, DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM, 4, &pixel);
+		sampler.init(dx11.device);
+
+		quads.init(dx11, NUM_QUADS)
+			.camera(camera2d)
+			.sampler(sampler.sampler)
+			.texture(white.srv);
+
+		/// A quarter of the quads are rotated
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> x(0, 1200), y(0, 800), c(0.2f, 1);
+		for(uint i = 0; i < NUM_QUADS; i++) {
+			quads.color({c(rng), c(rng), c(rng), 1})
+				 .quad({x(rng), y(rng)}, {3, 3}, i % 4 == 0 ? x(rng) : 0);
+		}
+
+		benchmark();
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		quads.update(frame);
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		quads.render(frame);
+	}
+private:
+	/// Best of REPEATS for each thread count. The calling thread is one of the threads
+	void benchmark() {
+		uint maxThreads = dx11.threads.size() + 1;
+		Log::format("Quad benchmark: %u quads, 1 to %u threads", NUM_QUADS, maxThreads);
+
+		double single = 0;
+		for(uint n = 1; n <= maxThreads; n++) {
+			unique_ptr<ThreadPool> pool;
+			if(n > 1) pool = std::make_unique<ThreadPool>(n - 1);
+			quads.threads(pool.get());
+
+			double best = DBL_MAX;
+			for(int i = 0; i < REPEATS; i++) {
+				auto start = high_resolution_clock::now();
+				quads.prepare();
+				best = std::min(best, (high_resolution_clock::now() - start).count() * 1e-6);
+			}
+			if(n == 1) single = best;
+			Log::format("\t%2u thread(s) : %.2f ms (%.2fx)", n, best, single / best);
+		}
+		quads.threads(&dx11.threads);
+	}
+};
@@ -0,0 +1,171 @@
+#pragma once
+///
+///	Rasterises the printable ASCII glyphs of Arial at 256 pixels with GDI into a plain
+///	coverage sheet, turns that into a 48 pixel distance field font with SDFGenerator and
+///	displays it next to the pre-baked arial font.
+///
+class ExampleSDFGenerator final : public BaseExample {
+	static constexpr uint SOURCE_SIZE = 256;
+	static constexpr uint SHEET_WIDTH = 2048;
+	Camera2D camera2d;
+	Text original, generated;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 SDF Generator";
+		params.width = 1000;
+		params.height = 400;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		wstring source = params.fontsDirectory + L"arial-coverage-256";
+
+		auto start = high_resolution_clock::now();
+		rasterise(L"Arial", SOURCE_SIZE, source);
+		Log::format("Rasterised in %.3f ms", (high_resolution_clock::now() - start).count() * 1e-6);
+
+		SDFParams sdf;
+		sdf.size = 48;
+		sdf.spread = 6;
+
+		start = high_resolution_clock::now();
+		SDFGenerator::generate(source, params.fontsDirectory + L"arial-sdf-48", sdf, &dx11.threads);
+		Log::format("Generated in %.3f ms", (high_resolution_clock::now() - start).count() * 1e-6);
+
+		camera2d.init(dx11.windowSize());
+
+		original.init(dx11, dx11.fonts.get(L"arial"), true, 64)
+			.camera(camera2d)
+			.setSize(64)
+			.appendText("Original arial 32", 20, 50);
+
+		generated.init(dx11, dx11.fonts.get(L"arial-sdf-48"), true, 64)
+			.camera(camera2d)
+			.setSize(64)
+			.appendText("Generated arial 48", 20, 200);
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		original.update(frame);
+		generated.update(frame);
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.1f, 0.2f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		original.render(frame);
+		generated.render(frame);
+	}
+private:
+	///	Write _dest_.fnt and _dest_.png holding the glyphs of the installed font _faceName_
+	///	at _size_ pixels as coverage in the alpha channel, which is the input SDFGenerator expects
+	static void rasterise(const wstring& faceName, uint size, const wstring& dest) {
+		HDC dc = CreateCompatibleDC(nullptr);
+		HFONT hfont = CreateFontW(-(int)size, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+								  DEFAULT_CHARSET, OUT_TT_ONLY_PRECIS, CLIP_DEFAULT_PRECIS, ANTIALIASED_QUALITY,
+								  DEFAULT_PITCH, faceName.c_str());
+		if(!dc || !hfont) {
+			if(hfont) DeleteObject(hfont);
+			if(dc) DeleteDC(dc);
+			throw std::runtime_error("Unable to create font '" + WString::toString(faceName) + "'");
+		}
+		HGDIOBJ previous = SelectObject(dc, hfont);
+		TEXTMETRICW tm = {};
+		GetTextMetricsW(dc, &tm);
+
+		const MAT2 identity = {{0, 1}, {0, 0}, {0, 0}, {0, 1}};
+		vector<ubyte> coverage;
+		vector<ubyte> bitmap;
+		string chars;
+		uint numChars = 0;
+		uint x = 1, y = 1, shelfHeight = 0;
+		for(uint ch = 32; ch < 127; ch++) {
+			GLYPHMETRICS gm = {};
+			DWORD bytes = GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, 0, nullptr, &identity);
+			if(bytes != GDI_ERROR && bytes > 0) {
+				bitmap.resize(bytes);
+				bytes = GetGlyphOutlineW(dc, ch, GGO_GRAY8_BITMAP, &gm, bytes, bitmap.data(), &identity);
+			}
+			if(bytes == GDI_ERROR) continue;
+
+			/// Blank glyphs (eg. ' ') only have an advance
+			uint w = bytes > 0 ? gm.gmBlackBoxX : 0;
+			uint h = bytes > 0 ? gm.gmBlackBoxY : 0;
+			uint gx = 0, gy = 0;
+			if(w > 0) {
+				if(x + w + 1 > SHEET_WIDTH) {
+					x = 1;
+					y += shelfHeight + 1;
+					shelfHeight = 0;
+				}
+				gx = x;
+				gy = y;
+				size_t rows = (size_t)gy + h + 1;
+				if(coverage.size() < rows * SHEET_WIDTH) coverage.resize(rows * SHEET_WIDTH, 0);
+
+				/// GGO_GRAY8_BITMAP rows are 4 byte aligned and have 65 levels (0..64)
+				uint pitch = (w + 3) & ~3u;
+				for(uint row = 0; row < h; row++) {
+					for(uint col = 0; col < w; col++) {
+						coverage[(gy + row) * (size_t)SHEET_WIDTH + gx + col] = (ubyte)(bitmap[row*pitch + col] * 255 / 64);
+					}
+				}
+				x += w + 1;
+				shelfHeight = std::max(shelfHeight, h);
+			}
+			chars += String::format("char id=%u x=%u y=%u width=%u height=%u xoffset=%d yoffset=%d xadvance=%d page=0 chnl=15\n",
+									ch, gx, gy, w, h, (int)gm.gmptGlyphOrigin.x, (int)(tm.tmAscent - gm.gmptGlyphOrigin.y), (int)gm.gmCellIncX);
+			numChars++;
+		}
+
+		string kernings;
+		uint numKernings = 0;
+		DWORD numPairs = GetKerningPairsW(dc, 0, nullptr);
+		if(numPairs > 0) {
+			vector<KERNINGPAIR> pairs(numPairs);
+			numPairs = GetKerningPairsW(dc, numPairs, pairs.data());
+			for(uint i = 0; i < numPairs; i++) {
+				auto& p = pairs[i];
+				if(p.iKernAmount == 0 || p.wFirst < 32 || p.wFirst > 126 || p.wSecond < 32 || p.wSecond > 126) continue;
+				kernings += String::format("kerning first=%u second=%u amount=%d\n", (uint)p.wFirst, (uint)p.wSecond, p.iKernAmount);
+				numKernings++;
+			}
+		}
+		SelectObject(dc, previous);
+		DeleteObject(hfont);
+		DeleteDC(dc);
+
+		/// White with the coverage in alpha
+		uint2 sheetSize = {SHEET_WIDTH, (uint)(coverage.size() / SHEET_WIDTH)};
+		vector<ubyte> rgba(coverage.size() * 4, 255);
+		for(size_t i = 0; i < coverage.size(); i++) rgba[i*4 + 3] = coverage[i];
+		wstring pageName = dest.substr(dest.find_last_of(L"/\\") + 1) + L".png";
+		SDFGenerator::writePNG(dest + L".png", rgba.data(), sheetSize);
+
+		string fnt;
+		fnt += String::format("info face=\"%s\" size=%u bold=0 italic=0 charset=\"\" unicode=1 stretchH=100 smooth=1 aa=1 padding=0,0,0,0 spacing=1,1\n",
+							  WString::toString(faceName).c_str(), size);
+		fnt += String::format("common lineHeight=%d base=%d scaleW=%u scaleH=%u pages=1 packed=0\n",
+							  (int)(tm.tmHeight + tm.tmExternalLeading), (int)tm.tmAscent, sheetSize.x, sheetSize.y);
+		fnt += String::format("page id=0 file=\"%s\"\n", WString::toString(pageName).c_str());
+		fnt += String::format("chars count=%u\n", numChars);
+		fnt += chars;
+		fnt += String::format("kernings count=%u\n", numKernings);
+		fnt += kernings;
+
+		FILE* fp = nullptr;
+		wstring fntFilename = dest + L".fnt";
+		if(_wfopen_s(&fp, fntFilename.c_str(), L"wb") != 0 || !fp) {
+			throw std::runtime_error("Unable to write '" + WString::toString(fntFilename) + "'");
+		}
+		bool ok = fwrite(fnt.data(), 1, fnt.size(), fp) == fnt.size();
+		fclose(fp);
+		if(!ok) throw std::runtime_error("Unable to write '" + WString::toString(fntFilename) + "'");
+	}
+};
@@ -0,0 +1,81 @@
+#pragma once
+///
+///	A dashboard of a few hundred small Text objects in three fonts drawn by one TextBatch.
+///	A handful of values change every frame; only their glyph slots are uploaded.
+///
+class ExampleTextBatch final : public BaseExample {
+	Camera2D camera2d;
+	TextBatch batch;
+	static constexpr uint COLUMNS = 12;
+	static constexpr uint ROWS = 30;
+	vector<unique_ptr<Text>> labels;
+	vector<unique_ptr<Text>> values;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Text Batch";
+		params.width = 1400;
+		params.height = 800;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = false;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		Font* arial = dx11.fonts.get(L"arial");
+		Font* segoe = dx11.fonts.get(L"segoe-ui-black");
+		GlyphCacheParams gcp;
+		Font* gothic = dx11.fonts.getTrueType(L"", L"MS Gothic", gcp);
+
+		batch.init(dx11, {arial, segoe, gothic}, 64 * 1024)
+			.camera(camera2d)
+			.setOutline({0, 0, 0, 1}, 0.05f);
+
+		for(uint y = 0; y < ROWS; y++) {
+			for(uint x = 0; x < COLUMNS; x++) {
+				int px = 10 + (int)x * 115;
+				int py = 10 + (int)y * 26;
+
+				auto label = std::make_unique<Text>();
+				label->init(dx11, (x + y) % 2 ? arial : gothic, false, 16, true)
+					.setSize(12)
+					.setColour({0.7f, 0.7f, 0.7f, 1})
+					.appendText(String::format("sensor %u", y * COLUMNS + x), px, py);
+				batch.add(*label);
+				labels.push_back(std::move(label));
+
+				auto value = std::make_unique<Text>();
+				value->init(dx11, segoe, false, 16, true)
+					.setSize(14)
+					.setColour({0.4f, 1, 0.4f, 1})
+					.appendText("0", px + 60, py);
+				batch.add(*value);
+				values.push_back(std::move(value));
+			}
+		}
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		/// Change a few values each frame
+		for(uint i = 0; i < 8; i++) {
+			uint index = (uint)((frame.number * 8 + i) % values.size());
+			values[index]->replaceText(0, String::format("%.2f", (frame.number % 1000) * 0.37f + index));
+		}
+		batch.update(frame);
+
+		if(frame.number % 300 == 0) {
+			Log::format("%u Text objects drawn with %u draw call(s)", (uint)(labels.size() + values.size()), batch.numDrawCalls());
+		}
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.05f, 0.05f, 0.1f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		batch.render(frame);
+	}
+};
@@ -0,0 +1,63 @@
+#pragma once
+///
+///	A log that grows by a few hundred lines per frame. Only the visible rows are turned
+///	into glyphs. The mouse wheel scrolls; scrolling to the bottom follows the tail again.
+///
+class ExampleTextView final : public BaseExample {
+	Camera2D camera2d;
+	TextView view;
+	ulong lineNumber = 0;
+	int mouseScroll = 0;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Text View";
+		params.width = 1000;
+		params.height = 600;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = true;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		TextViewParams tvp;
+		tvp.x = 10;
+		tvp.y = 10;
+		tvp.width = 980;
+		tvp.height = 580;
+		tvp.size = 16;
+		view.init(dx11, dx11.fonts.get(L"arial"), tvp)
+			.camera(camera2d);
+
+		Log::format("Application setup finished");
+	}
+	void mouseWheel(int delta, KeyMod mod) final override {
+		mouseScroll = delta;
+	}
+	void render(const FrameResource& frame) final override {
+		string lines;
+		for(uint i = 0; i < 300; i++, lineNumber++) {
+			lines += String::format("%llu: the quick brown fox jumps over the lazy dog %llu times\n", lineNumber, lineNumber * 7);
+		}
+		view.append(lines);
+
+		if(mouseScroll != 0) {
+			view.scrollBy(mouseScroll > 0 ? -3 : 3);
+			mouseScroll = 0;
+		}
+		if(frame.number % 60 == 0) {
+			Log::format("%u lines, %u rows, %llu bytes", view.numLines(), view.numRows(), (ulong)view.getDocument().size());
+		}
+		view.update(frame);
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.1f, 0.2f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		view.render(frame);
+	}
+};
@@ -0,0 +1,84 @@
+#pragma once
+///
+///	A world of a million tiles kept in a Quad with a spatial index. Only the tiles under a
+///	wandering view rect are uploaded and drawn. A few hundred tiles move every frame through
+///	their handles, which only updates the index.
+///
+class ExampleTileMap final : public BaseExample {
+	static constexpr uint TILES = 1000;
+	static constexpr float TILE_SIZE = 4;
+	static constexpr uint MOVERS = 256;
+	Camera2D camera2d;
+	Texture2D white;
+	Sampler sampler;
+	Quad tiles;
+	vector<QuadHandle> movers;
+public:
+	void init(HINSTANCE hInstance, int cmdShow) final override {
+		params.title = L"DX11 Tile Map";
+		params.width = 1200;
+		params.height = 800;
+		params.windowMode = WindowMode::WINDOWED;
+		params.vsync = false;
+		BaseExample::init(hInstance, cmdShow);
+	}
+	void setup() final override {
+		Log::format("Application setup");
+
+		camera2d.init(dx11.windowSize());
+
+		/// Untextured tiles. The colour comes from the quad
+		const uint pixel = 0xffffffff;
+		white.init(dx11.device, {1, 1}, DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM, 4, &pixel);
+		sampler.init(dx11.device);
+
+		tiles.init(dx11, TILES * TILES + MOVERS, true)
+			.camera(camera2d)
+			.sampler(sampler.sampler)
+			.texture(white.srv)
+			.enableSpatialIndex(64);
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> shade(0.2f, 0.8f);
+		for(uint y = 0; y < TILES; y++) {
+			for(uint x = 0; x < TILES; x++) {
+				float g = shade(rng);
+				tiles.color({g * 0.5f, g, g * 0.3f, 1})
+					 .quad({x * TILE_SIZE, y * TILE_SIZE}, {TILE_SIZE - 1, TILE_SIZE - 1});
+			}
+		}
+		tiles.color({1, 1, 0, 1});
+		for(uint i = 0; i < MOVERS; i++) {
+			movers.push_back(tiles.add({0, 0}, {TILE_SIZE * 2, TILE_SIZE * 2}));
+		}
+
+		Log::format("Application setup finished");
+	}
+	void render(const FrameResource& frame) final override {
+		float t = (float)(frame.nsecs * 1e-9);
+
+		/// The view wanders around the window
+		float2 centre = {600 + std::cos(t * 0.3f) * 350, 400 + std::sin(t * 0.5f) * 250};
+		tiles.setCullRect({centre.x - 200, centre.y - 150, 400, 300});
+
+		for(uint i = 0; i < MOVERS; i++) {
+			float a = t + i * 0.1f;
+			tiles.move(movers[i], {centre.x + std::cos(a) * (50.0f + i), centre.y + std::sin(a * 1.3f) * (40.0f + i)});
+		}
+		tiles.update(frame);
+
+		if(frame.number % 300 == 0) {
+			auto& s = tiles.cullStats();
+			Log::format("cells visited %u, quads tested %u, emitted %u of %u, draw calls %u",
+				s.cellsVisited, s.quadsTested, s.quadsEmitted, tiles.numQuads(), s.drawCalls);
+		}
+
+		auto context = frame.context;
+		context->OMSetRenderTargets(1, frame.renderTargetView.GetAddressOf(), nullptr);
+
+		float clearColor[] = {0.0f, 0.0f, 0.0f, 0.0f};
+		context->ClearRenderTargetView(frame.renderTargetView.Get(), clearColor);
+
+		tiles.render(frame);
+	}
+};
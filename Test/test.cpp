@@ -28,6 +28,22 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 	ExampleComputeToTexture app;
 #elif TEST==5
     ExampleShaderPrintf app;
+#elif TEST==6
+    ExampleKerningBenchmark app;
+#elif TEST==7
+    ExampleSDFGenerator app;
+#elif TEST==8
+    ExampleDynamicFont app;
+#elif TEST==9
+    ExampleGpuText app;
+#elif TEST==10
+    ExampleTextView app;
+#elif TEST==11
+    ExampleTextBatch app;
+#elif TEST==12
+    ExampleTileMap app;
+#elif TEST==13
+    ExampleQuadBenchmark app;
 #endif
 	try{
 		app.init(hInstance, nCmdShow);